@@ -0,0 +1,60 @@
+#ifndef QT_EXECUTOR_H
+#define QT_EXECUTOR_H
+
+#include <QCoreApplication>
+#include <QMetaObject>
+#include <QObject>
+#include <boost/asio/execution.hpp>
+#include <boost/asio/execution_context.hpp>
+#include <memory>
+
+// The Qt event loop as an asio execution context. Work is queued to this object, so
+// destroying it drops whatever is still pending; that happens before the asio services
+// (strands among them) go away, since queued strand invokers still point into them.
+class qt_execution_context : public boost::asio::execution_context, public QObject
+{
+public:
+    ~qt_execution_context() override
+    {
+        QCoreApplication::removePostedEvents(this);
+        shutdown();
+        destroy();
+    }
+};
+
+// Runs asio handlers on the Qt event loop. Handed to client::set_delegate_executor(),
+// it brings delegate callbacks onto the GUI thread without polling the io_context.
+class qt_executor
+{
+public:
+    explicit qt_executor(qt_execution_context& context) noexcept
+        : context_(&context)
+    {
+    }
+
+    boost::asio::execution_context& query(boost::asio::execution::context_t) const noexcept
+    {
+        return *context_;
+    }
+    static constexpr boost::asio::execution::blocking_t query(boost::asio::execution::blocking_t) noexcept
+    {
+        return boost::asio::execution::blocking.never;
+    }
+    qt_executor require(boost::asio::execution::blocking_t::never_t) const noexcept { return *this; }
+
+    template<typename Function>
+    void execute(Function f) const
+    {
+        // Qt wants copyable functors, asio handlers may be move-only
+        auto handler = std::make_shared<Function>(std::move(f));
+        QMetaObject::invokeMethod(context_, [handler]() { (*handler)(); }, Qt::QueuedConnection);
+    }
+
+    bool operator==(const qt_executor& other) const noexcept { return context_ == other.context_; }
+    bool operator!=(const qt_executor& other) const noexcept { return context_ != other.context_; }
+
+private:
+    qt_execution_context* context_;
+};
+
+#endif // QT_EXECUTOR_H
@@ -1,23 +1,29 @@
 #include "widget.h"
+#include <QPaintEvent>
 #include <QPainter>
-#include <QTimer>
 
 Widget::Widget(QWidget* parent)
     : QWidget(parent)
-    , client_(ioc_, this)
+    , work_(ioc_.get_executor())
+    , client_(ioc_.get_executor(), this)
 {
-    auto timer = new QTimer(this);
-    timer->setInterval(10);
-    timer->start();
-    connect(timer, &QTimer::timeout, this, [this]() { ioc_.poll(); });
+    client_.set_delegate_executor(qt_executor(gui_context_));
     client_.set_host("127.0.0.1");
     //client_.set_host("192.168.101.8");
     //client_.set_host("100.64.0.15");
+    //client_.set_wire_format(libvnc::client::wire_format::rgb565);
+    //client_.set_auto_select(true);
+    client_.set_present_interval(std::chrono::milliseconds(16));
     client_.start();
+    thread_ = std::thread([this]() { ioc_.run(); });
 }
 
 Widget::~Widget()
 {
+    client_.stop();
+    work_.reset();
+    ioc_.stop();
+    thread_.join();
 }
 
 void Widget::on_connect(const libvnc::error& ec)
@@ -36,6 +42,16 @@ void Widget::on_frame_update(const libvnc::frame_buffer& buffer)
     this->update();
 }
 
+void Widget::on_frame_damage(const libvnc::frame_buffer& buffer, const libvnc::region& damage)
+{
+    if (image_.constBits() != buffer.data() || image_.width() != buffer.width() ||
+        image_.height() != buffer.height())
+        image_ = QImage(buffer.data(), buffer.width(), buffer.height(), QImage::Format_RGB32);
+
+    for (const auto& r : damage.rects())
+        this->update(r.x, r.y, r.w, r.h);
+}
+
 void Widget::on_new_frame_size(int w, int h)
 {
     this->resize(w, h);
@@ -62,8 +78,8 @@ void Widget::on_cursor_shape(int xhot,
     // this->update();
 }
 
-void Widget::paintEvent(QPaintEvent*)
+void Widget::paintEvent(QPaintEvent* event)
 {
     QPainter painter(this);
-    painter.drawImage(this->rect(), image_);
+    painter.drawImage(event->rect(), image_, event->rect());
 }
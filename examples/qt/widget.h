@@ -2,7 +2,11 @@
 #define WIDGET_H
 
 #include "libvnc-cpp/client.h"
+#include "qt_executor.h"
 #include <QWidget>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <thread>
 
 class Widget : public QWidget, public libvnc::client_delegate
 {
@@ -16,6 +20,7 @@ protected:
     void on_connect(const libvnc::error& ec) override;
     void on_disconnect(const libvnc::error& ec) override;
     void on_frame_update(const libvnc::frame_buffer& buffer) override;
+    void on_frame_damage(const libvnc::frame_buffer& buffer, const libvnc::region& damage) override;
     void on_new_frame_size(int w, int h) override;
     void on_cursor_shape(int xhot,
                          int yhot,
@@ -24,8 +29,14 @@ protected:
     void paintEvent(QPaintEvent*) override;
 
 private:
+    // The connection runs on its own thread, callbacks come back through gui_context_.
+    // Declared first so it outlives ioc_: handlers left in ioc_ can hold the client's
+    // delegate strand, which lives in gui_context_.
+    qt_execution_context gui_context_;
     boost::asio::io_context ioc_;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_;
     libvnc::client client_;
+    std::thread thread_;
     QImage image_;
 };
 #endif // WIDGET_H
@@ -0,0 +1,101 @@
+// Drives one client from a thread_pool and hammers it from several application threads:
+// input, live setting changes and the getters that are documented as thread-safe. Run it
+// under ThreadSanitizer against a test server, e.g. `stress_example 127.0.0.1 5900 30`.
+#include "libvnc-cpp/client.h"
+#include <boost/asio/thread_pool.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+class delegate : public libvnc::client_delegate
+{
+public:
+    void on_connect(const libvnc::error& ec) override
+    {
+        if (!ec)
+            ++connects_;
+    }
+    void on_disconnect(const libvnc::error&) override { ++disconnects_; }
+    void on_new_frame_size(int, int) override {}
+    void on_frame_update(const libvnc::frame_buffer&) override {}
+    void on_frame_damage(const libvnc::frame_buffer& frame, const libvnc::region& damage) override
+    {
+        // inline delivery runs on the protocol strand, where frame() may be read
+        for (const auto& r : damage.rects())
+            checksum_ += frame.check_rect(r.x, r.y, r.w, r.h) ? *frame.data(r.x, r.y) : 0;
+        ++frames_;
+    }
+
+    std::atomic_int connects_ = 0;
+    std::atomic_int disconnects_ = 0;
+    std::atomic_int frames_ = 0;
+    unsigned checksum_ = 0;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const char* host = argc > 1 ? argv[1] : "127.0.0.1";
+    int port = argc > 2 ? std::atoi(argv[2]) : 5900;
+    auto duration = std::chrono::seconds(argc > 3 ? std::atoi(argv[3]) : 10);
+
+    boost::asio::thread_pool pool(4);
+    delegate handler;
+    libvnc::client client(pool.get_executor(), &handler);
+    client.set_host(host);
+    client.set_port(port);
+    client.set_request_pipeline_depth(2);
+    client.start();
+
+    std::atomic_bool running = true;
+    std::atomic<long> sent = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; running; ++i) {
+                if (client.current_status() != libvnc::client::status::connected) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    continue;
+                }
+                client.send_pointer_event((i * 7 + t) % 640, (i * 3) % 480, 0);
+                if (t == 0 && i % 64 == 0) {
+                    // shift down and up, always in pairs so no key stays held
+                    client.send_key_event(0xffe1, true);
+                    client.send_key_event(0xffe1, false);
+                }
+                if (t == 1 && i % 256 == 0)
+                    client.set_max_fps(i % 512 == 0 ? 0 : 10);
+                if (t == 2 && i % 512 == 0)
+                    client.send_frame_encodings({"tight", "zrle", "raw"});
+                if (t == 3 && i % 128 == 0)
+                    client.set_quality_level((i / 128) % 10);
+                (void)client.monitors();
+                (void)client.current_keyboard_led_state();
+                (void)client.dropped_events();
+                ++sent;
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(duration);
+    running = false;
+    for (auto& thread : threads)
+        thread.join();
+    client.stop();
+    pool.join();
+
+    std::printf("connects %d, disconnects %d, frames %d, input calls %ld, dropped events %llu\n",
+                handler.connects_.load(),
+                handler.disconnects_.load(),
+                handler.frames_.load(),
+                sent.load(),
+                static_cast<unsigned long long>(client.dropped_events()));
+    return handler.connects_ > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
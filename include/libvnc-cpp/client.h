@@ -2,21 +2,79 @@
 #include "error.h"
 #include "frame_buffer.h"
 #include "proto.h"
+#include "region.h"
 #include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <set>
+#include <string>
 
 namespace libvnc {
 
 class client_delegate;
 class client_impl;
+
+/** Runs on two strands of the executor it is given, so a single-threaded io_context, one run
+    from several threads and a thread_pool are all supported. The protocol strand reads and
+    the writer strand writes; a socket never has more than one of each in flight, and TLS
+    writes go through the protocol strand since both directions share the session.
+
+    Safe from any thread while running: start(), stop(), send_*, text_chat_*,
+    permit_server_input(), present_tick(), current_status(), current_keyboard_led_state(),
+    monitors(), dropped_events() and the set_* calls not listed below. Call set_host(),
+    set_port(), set_share_desktop(), set_notifiction_text(), set_wire_format() and
+    set_delegate_executor() before start(). frame() belongs to the protocol strand: read it in
+    a delegate callback delivered inline or from get_executor(), see below. */
 class client {
 public:
+	client(const boost::asio::any_io_executor &executor, client_delegate *handler);
 	client(boost::asio::io_context &executor, client_delegate *handler);
 	virtual ~client();
 
 	enum class status : uint32_t { closed = 0, connecting, handshaking, authenticating, initializing, connected };
 
+	/** Pixel format the server is asked to put on the wire.
+	    requested: the server converts into want_format() (default).
+	    server_native: the server keeps its own format and the client converts damaged rects locally.
+	    indexed8: 8bpp colour-mapped pixels, expanded locally through the server's colour map.
+	    bgr233, rgb565: reduced true-colour formats for slow links; frame() keeps want_format(). */
+	enum class wire_format : uint32_t { requested = 0, server_native, indexed8, bgr233, rgb565 };
+
+	/** Result of async_next_frame(): damage since the previous call and a frame counter. */
+	struct frame_update {
+		region damage{};
+		uint64_t generation = 0;
+	};
+
+	/** What async_next_event() completes with; mirrors the client_delegate notifications. */
+	struct event {
+		enum class type : uint32_t {
+			connect = 0,
+			disconnect,
+			status_changed,
+			new_frame_size,
+			cursor_pos,
+			keyboard_led_state,
+			monitor_info,
+			bell,
+			cut_text,
+			cut_text_utf8,
+			text_chat,
+		};
+		type kind = type::status_changed;
+		/* connect, disconnect */
+		error err{};
+		/* status_changed */
+		status state = status::closed;
+		/* new_frame_size (w, h), cursor_pos (x, y); led state and monitor count in x */
+		int x = 0, y = 0;
+		/* cut_text, cut_text_utf8, text_chat */
+		std::string text{};
+		proto::rfbTextChatType chat_type{};
+	};
+
 public:
 	void start();
 	void stop();
@@ -27,11 +85,85 @@ public:
 	void set_compress_level(int level);
 	void set_quality_level(int level);
 	void set_notifiction_text(std::string_view text);
-
+	void set_wire_format(wire_format format);
+	/** Lets the server push updates without waiting for a request when it supports the
+	    ContinuousUpdates extension (default on). Can be toggled while connected. */
+	void set_continuous_updates(bool enabled);
+	/** Without continuous updates, keeps up to max_depth incremental update requests in flight
+	    so the server prepares the next update while the current one is decoded. The depth in
+	    use follows the measured round trip and decode time. 1 (default) waits for each update. */
+	void set_request_pipeline_depth(int max_depth);
+	/** Chooses the preferred encoding and the compress/quality levels from the measured
+	    throughput and round trip time, re-sending SetEncodings when the link changes
+	    (default off). While on it overrides set_compress_level() and set_quality_level(). */
+	void set_auto_select(bool enabled);
+	/** Keeps the client responsive when decoding cannot keep up with the server. Once the
+	    average decode time of an update exceeds budget, JPEG quality is lowered step by step,
+	    then Hextile is preferred and fewer updates are requested; the steps are undone as headroom returns.
+	    Zero (default) disables it. */
+	void set_decode_budget(std::chrono::milliseconds budget);
+	/** Restricts incremental update requests to the visible parts of the frame, e.g. when
+	    the view is zoomed in. Rects are in frame coordinates; an empty list (default) means
+	    the whole frame. Newly visible parts are requested in full. */
+	void set_viewport(const std::vector<rect> &rects);
+	/** How often the frame outside the viewport is refreshed (default 2 s, zero never). */
+	void set_background_refresh(std::chrono::milliseconds interval);
+	/** Spaces out update requests while the screen is idle: after a few empty or tiny updates
+	    the interval doubles up to max_interval. Input or a larger change restores the full
+	    rate at once. Zero (default) requests the next update as soon as one arrives. */
+	void set_idle_backoff(std::chrono::milliseconds max_interval);
+	/** Caps the update rate by spacing out update requests, e.g. 2 for thumbnails. Changes
+	    in between are merged by the server into the next update. Continuous updates are
+	    not used while a cap is set. Zero (default) means no cap. */
+	void set_max_fps(int fps);
+	/** Spaces frame callbacks at least interval apart; updates arriving in between are
+	    merged into one callback with their combined damage. Protocol processing is not
+	    held up. Zero (default) calls back after every update. */
+	void set_present_interval(std::chrono::milliseconds interval);
+	/** Holds frame callbacks until present_tick(), e.g. driven by the display's vsync. */
+	void set_present_on_tick(bool enabled);
+	void present_tick();
+	/** Delivers the rects decoded so far, with their partial damage, whenever time_budget or
+	    byte_budget has passed within a single large update, so the top of the screen shows
+	    while the rest is still arriving. Zero (default) for both waits for the whole update. */
+	void set_progressive_updates(std::chrono::milliseconds time_budget, std::size_t byte_budget);
+	/** Requests the initial frame as Tight at the lowest JPEG quality, then switches to the
+	    configured quality. Best combined with set_lossless_refresh() (both default off). */
+	void set_fast_first_frame(bool enabled);
+	/** Keeps track of areas that arrived as JPEG and, once the screen has been still for a
+	    moment, asks for them again without JPEG. */
+	void set_lossless_refresh(bool enabled);
+	/** While a write is waiting on a congested link, pointer moves with unchanged buttons
+	    replace the previous queued move instead of piling up behind it. Button changes and
+	    key events always go out in order (default on). */
+	void set_pointer_coalescing(bool enabled);
+	/** Delivers delegate callbacks (except auth and want_format) on executor, merging frames
+	    while it is busy. Set it before start(); a default executor restores inline delivery. */
+	void set_delegate_executor(const boost::asio::any_io_executor &executor);
+
+	/** The client's strand. A coroutine on it may read the damage async_next_frame() returned
+	    from frame() until its next co_await; other areas can be halfway through an update. */
+	boost::asio::any_io_executor get_executor() const;
+
+	/** Waits for the next presented frame, merging frames missed in between. One waiter at a
+	    time; fails with operation_aborted once the client is closed. */
+	boost::asio::awaitable<error> async_next_frame(frame_update &update);
+	/** Waits for the next notification, buffered from the first call on; see dropped_events().
+	    Once the client is closed and the buffer drained it fails with operation_aborted. */
+	boost::asio::awaitable<error> async_next_event(event &ev);
+	/** Resume once the event is queued for sending, in order with the caller's other input. */
+	boost::asio::awaitable<bool> async_send_key(uint32_t key, bool down);
+	boost::asio::awaitable<bool> async_send_pointer(int x, int y, int button_mask);
+
+	/** Only valid on the protocol strand, see get_executor(). */
 	const frame_buffer &frame() const;
 	status current_status() const;
 	int current_keyboard_led_state() const;
+	/** Notifications lost because the delegate executor or the event consumer fell behind. */
+	uint64_t dropped_events() const;
 
+	/** Frame encodings to offer, best first. Kept for the session: automatic re-sends (auto
+	    select, decode budget, lossless refresh) only reorder this list. */
 	bool send_frame_encodings(const std::vector<std::string> &encodings);
 	bool send_scale_setting(int scale);
 	bool send_ext_desktop_size(const std::vector<proto::rfbExtDesktopScreen> &screens);
@@ -51,6 +183,8 @@ public:
 
 	bool send_xvp_msg(uint8_t version, proto::rfbXvpCode code);
 
+	/** Selects monitor nbr with UltraVNC SetMonitor. Servers without it keep sending the whole
+	    desktop, so the viewport follows the nbr-th ExtDesktopSize screen instead (0 for all). */
 	bool send_set_monitor(uint8_t nbr);
 	int monitors() const;
 
@@ -69,6 +203,9 @@ public:
 	virtual void on_disconnect(const error &ec) = 0;
 	virtual void on_new_frame_size(int w, int h) = 0;
 	virtual void on_frame_update(const frame_buffer &) = 0;
+	/** Called instead of on_frame_update with the parts changed since the last call;
+	    the default forwards to on_frame_update. */
+	virtual void on_frame_damage(const frame_buffer &frame, const region &damage);
 	virtual void on_keyboard_led_state(int state);
 	virtual void on_text_chat(const proto::rfbTextChatType &type, std::string_view message);
 	virtual void on_cut_text_utf8(std::string_view message);
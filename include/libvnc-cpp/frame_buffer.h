@@ -37,6 +37,7 @@ private:
 	std::atomic<int> width_ = 0;
 	std::atomic<int> height_ = 0;
 	proto::rfbPixelFormat format_;
+	uint8_t bytes_per_pixel_ = 0;
 	std::vector<uint8_t> data_;
 };
 } // namespace libvnc
\ No newline at end of file
@@ -57,6 +57,10 @@ enum rfbEncoding : uint32_t {
 	// Xvp pseudo-encoding
 	rfbEncodingXvp = 0xFFFFFECB,
 
+	// TigerVNC flow control pseudo-encodings
+	rfbEncodingContinuousUpdates = 0xFFFFFEC7, // -313
+	rfbEncodingFence = 0xFFFFFEC8,             // -312
+
 	// Special encoding numbers
 	rfbEncodingFineQualityLevel0 = 0xFFFFFE00,
 	rfbEncodingFineQualityLevel100 = 0xFFFFFE64,
@@ -125,6 +129,7 @@ enum rfbServerToClientMsg : uint8_t {
 	/* Modif sf@2002 */
 	rfbResizeFrameBuffer = 4,
 	rfbPalmVNCReSizeFrameBuffer = 0xF,
+	rfbEndOfContinuousUpdates = 150,
 	rfbServerState = 0xAD
 
 };
@@ -148,6 +153,9 @@ enum rfbClientToServerMsg : uint8_t {
 
 	rfbRequestSession = 20,
 	rfbSetSession = 21,
+	rfbEnableContinuousUpdates = 150,
+	/* Fence message - bidirectional */
+	rfbFence = 248,
 	rfbSetDesktopSize = 251,
 	rfbMonitorInfo = 252,
 	rfbSetMonitor = 254,
@@ -330,6 +338,29 @@ struct rfbFramebufferUpdateRectHeader {
 	boost::endian::big_uint32_buf_t encoding; /* one of the encoding types rfbEncoding... */
 };
 
+/*-----------------------------------------------------------------------------
+ * SetColourMapEntries - these messages are only sent if the pixel
+ * format uses a "colour map" (i.e. trueColour false) and the client has not
+ * fixed the entire colour map using FixColourMapEntries.  In addition they
+ * will only start being sent after the client has sent its first
+ * FramebufferUpdateRequest.  So if the client always tells the server to use
+ * trueColour then it never needs to process this type of message.
+ */
+
+struct rfbSetColourMapEntriesMsg {
+	boost::endian::big_uint8_buf_t pad;
+	boost::endian::big_uint16_buf_t firstColour;
+	boost::endian::big_uint16_buf_t nColours;
+
+	/* Followed by nColours * rfbColourMapEntry */
+};
+
+struct rfbColourMapEntry {
+	boost::endian::big_uint16_buf_t red;
+	boost::endian::big_uint16_buf_t green;
+	boost::endian::big_uint16_buf_t blue;
+};
+
 struct rfbXCursorColors {
 	boost::endian::big_uint8_buf_t foreRed;
 	boost::endian::big_uint8_buf_t foreGreen;
@@ -520,6 +551,64 @@ struct rfbSetServerInputMsg {
 	boost::endian::big_uint16_buf_t pad;
 };
 
+/*-----------------------------------------------------------------------------
+ * EnableContinuousUpdates client -> server message
+ *
+ * Asks the server to send updates for the area without waiting for
+ * FramebufferUpdateRequests. The server answers a disable with
+ * EndOfContinuousUpdates, and sends one unprompted to announce support.
+ */
+
+struct rfbEnableContinuousUpdatesMsg {
+	boost::endian::big_uint8_buf_t enable;
+	boost::endian::big_uint16_buf_t x;
+	boost::endian::big_uint16_buf_t y;
+	boost::endian::big_uint16_buf_t w;
+	boost::endian::big_uint16_buf_t h;
+};
+
+/*-----------------------------------------------------------------------------
+ * Fence - bidirectional
+ *
+ * A request is answered with the same payload and the request bit cleared,
+ * after everything sent before it has been processed.
+ */
+
+enum rfbFenceFlags : uint32_t {
+	rfbFenceFlagBlockBefore = 1 << 0,
+	rfbFenceFlagBlockAfter = 1 << 1,
+	rfbFenceFlagSyncNext = 1 << 2,
+	rfbFenceFlagRequest = 1u << 31,
+	/* SyncNext is not implemented, so it is cleared from replies */
+	rfbFenceFlagsSupported = rfbFenceFlagBlockBefore | rfbFenceFlagBlockAfter | rfbFenceFlagRequest
+};
+
+struct rfbFenceMsg {
+	boost::endian::big_uint8_buf_t pad1;
+	boost::endian::big_uint16_buf_t pad2;
+	boost::endian::big_uint32_buf_t flags;
+	boost::endian::big_uint8_buf_t length; /* at most 64 */
+	/* followed by char data[length] */
+};
+
+/*-----------------------------------------------------------------------------
+ * ServerState - UltraVNC, sent after EnableKeepAlive / EnableIdleTime
+ */
+
+enum rfbServerStateType : uint32_t {
+	rfbServerState_Disabled = 0,
+	rfbServerRemoteInputsState = 1,
+	rfbKeepAliveInterval = 2,
+	rfbIdleInputTimeout = 3
+};
+
+struct rfbServerStateMsg {
+	boost::endian::big_uint8_buf_t pad1;
+	boost::endian::big_uint16_buf_t pad2;
+	boost::endian::big_uint32_buf_t state;
+	boost::endian::big_uint32_buf_t value; /* seconds for the interval and timeout states */
+};
+
 struct rfbMonitorMsg {
 	boost::endian::big_uint8_buf_t nbr;
 	boost::endian::big_uint8_buf_t pad2;
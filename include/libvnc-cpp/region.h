@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace libvnc {
+
+struct rect {
+	int x = 0;
+	int y = 0;
+	int w = 0;
+	int h = 0;
+
+	bool empty() const { return w <= 0 || h <= 0; }
+	int right() const { return x + w; }
+	int bottom() const { return y + h; }
+	std::size_t area() const { return empty() ? 0 : std::size_t(w) * h; }
+
+	bool contains(const rect &other) const;
+	bool intersects(const rect &other) const;
+	rect intersected(const rect &other) const;
+	rect united(const rect &other) const;
+};
+
+/** A damage region: a small list of non-redundant rectangles.
+    Adjacent rectangles are merged and the list collapses into its bounding box
+    once it grows past max_rects, so the cost of tracking stays bounded. */
+class region {
+public:
+	constexpr static std::size_t max_rects = 64;
+
+	void add(const rect &r);
+	void add(const region &other);
+	void subtract(const rect &r);
+	void clear();
+
+	bool empty() const;
+	rect bounds() const;
+	std::size_t area() const;
+	const std::vector<rect> &rects() const;
+
+private:
+	std::vector<rect> rects_;
+	rect bounds_;
+};
+
+} // namespace libvnc
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+namespace libvnc::simd {
+
+/** Instruction set used by the pixel conversion and fill kernels. */
+enum class level : uint32_t { scalar = 0, sse2, avx2, avx512, neon };
+
+/** Best level the running CPU supports, detected once. */
+level detected_level();
+
+/** Level the kernels currently use. Defaults to detected_level(); the
+    LIBVNC_SIMD environment variable (scalar, sse2, avx2, avx512, neon)
+    overrides it at startup. */
+level active_level();
+
+/** Forces the kernels to a level, e.g. for benchmarking. Levels the CPU cannot
+    run fall back to the best supported one below it. Returns the level in use. */
+level set_level(level l);
+
+std::string_view level_name(level l);
+
+} // namespace libvnc::simd
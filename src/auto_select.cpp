@@ -0,0 +1,108 @@
+#include "auto_select.hpp"
+#include <algorithm>
+
+namespace libvnc {
+
+void auto_select::reset()
+{
+	pending_bytes_ = 0;
+	pending_wait_ = {};
+	kbps_ = 0;
+	rtt_ = {};
+	current_.reset();
+	candidate_.reset();
+	candidate_count_ = 0;
+	fresh_sample_ = false;
+}
+
+void auto_select::on_update(std::uint64_t bytes, clock::duration wait)
+{
+	pending_bytes_ += bytes;
+	pending_wait_ += wait;
+
+	/* small updates say little about the link, collect a few first */
+	if (pending_bytes_ < sample_bytes && pending_wait_ < sample_wait)
+		return;
+
+	auto us = std::max<std::int64_t>(
+		std::chrono::duration_cast<std::chrono::microseconds>(pending_wait_).count(), 1);
+	auto kbps = static_cast<std::uint32_t>(std::min<std::uint64_t>(pending_bytes_ * 8000 / us, UINT32_MAX));
+	pending_bytes_ = 0;
+	pending_wait_ = {};
+
+	/* moving average, 1/4 weight for the new sample */
+	if (kbps_ == 0)
+		kbps_ = kbps;
+	else
+		kbps_ = static_cast<std::uint32_t>((std::uint64_t(kbps_) * 3 + kbps) / 4);
+	fresh_sample_ = true;
+}
+
+void auto_select::on_rtt(clock::duration rtt)
+{
+	if (rtt_ == clock::duration::zero())
+		rtt_ = rtt;
+	else
+		rtt_ += (rtt - rtt_) / 4;
+}
+
+std::optional<auto_select::settings> auto_select::poll()
+{
+	if (!fresh_sample_)
+		return std::nullopt;
+	fresh_sample_ = false;
+
+	auto wanted = classify();
+	if (current_ == wanted) {
+		candidate_.reset();
+		candidate_count_ = 0;
+		return std::nullopt;
+	}
+
+	if (candidate_ != wanted) {
+		candidate_ = wanted;
+		candidate_count_ = 0;
+	}
+	/* the first measurement decides straight away, later ones need to agree a few times */
+	if (current_ && ++candidate_count_ < agree_count)
+		return std::nullopt;
+
+	current_ = wanted;
+	candidate_.reset();
+	candidate_count_ = 0;
+	return current_;
+}
+
+const std::optional<auto_select::settings> &auto_select::current() const
+{
+	return current_;
+}
+
+std::uint32_t auto_select::kbits_per_second() const
+{
+	return kbps_;
+}
+
+auto_select::clock::duration auto_select::rtt() const
+{
+	return rtt_;
+}
+
+auto_select::settings auto_select::classify() const
+{
+	using namespace std::chrono_literals;
+
+	/* raw only pays off when the link is faster than any codec and the peer is known to be
+	   close by; without a fence reply there is no round trip to go on */
+	if (kbps_ >= 256 * 1000 && rtt_ > 0ms && rtt_ <= 2ms)
+		return {"raw", 0, 9};
+	if (kbps_ >= 16 * 1000)
+		return {"zrle", 1, 9};
+	if (kbps_ >= 1500)
+		return {"tight", 2, 7};
+	if (kbps_ >= 256)
+		return {"tight", 6, 5};
+	return {"tight", 9, 2};
+}
+
+} // namespace libvnc
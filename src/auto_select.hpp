@@ -0,0 +1,55 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace libvnc {
+
+/** Picks the preferred encoding and compress/quality levels from the measured link.
+    Throughput is the bytes of each update over the time spent waiting on the socket
+    for them, so slow decoding does not read as a slow network. A new choice is only
+    reported after several consecutive measurements agree on it. */
+class auto_select {
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct settings {
+		std::string encoding;
+		int compress_level = 0;
+		int quality_level = 0;
+
+		bool operator==(const settings &) const = default;
+	};
+
+	void reset();
+
+	void on_update(std::uint64_t bytes, clock::duration wait);
+	void on_rtt(clock::duration rtt);
+
+	/** Returns the settings to switch to, once, when they differ from the current ones. */
+	std::optional<settings> poll();
+	const std::optional<settings> &current() const;
+
+	std::uint32_t kbits_per_second() const;
+	clock::duration rtt() const;
+
+private:
+	settings classify() const;
+
+	constexpr static std::uint64_t sample_bytes = 64 * 1024;
+	constexpr static auto sample_wait = std::chrono::milliseconds(50);
+	constexpr static int agree_count = 3;
+
+	std::uint64_t pending_bytes_ = 0;
+	clock::duration pending_wait_{};
+	std::uint32_t kbps_ = 0;
+	clock::duration rtt_{};
+
+	std::optional<settings> current_;
+	std::optional<settings> candidate_;
+	int candidate_count_ = 0;
+	bool fresh_sample_ = false;
+};
+
+} // namespace libvnc
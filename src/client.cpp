@@ -1,16 +1,23 @@
 #include "libvnc-cpp/client.h"
 #include "client_impl.h"
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/use_awaitable.hpp>
 #include <iostream>
 #include <ranges>
 
 namespace libvnc {
 
-client::client(boost::asio::io_context &executor, client_delegate *handler)
-	: impl_(std::make_shared<client_impl>(executor.get_executor()))
+client::client(const boost::asio::any_io_executor &executor, client_delegate *handler)
+	: impl_(std::make_shared<client_impl>(executor))
 {
 	impl_->handler_.reset(handler);
 }
 
+client::client(boost::asio::io_context &executor, client_delegate *handler)
+	: client(executor.get_executor(), handler)
+{
+}
+
 client::~client()
 {
 	impl_->handler_.reset(nullptr);
@@ -57,6 +64,138 @@ void client::set_notifiction_text(std::string_view text)
 	impl_->notifiction_text_ = text;
 }
 
+void client::set_wire_format(wire_format format)
+{
+	impl_->wire_format_ = format;
+}
+
+void client::set_continuous_updates(bool enabled)
+{
+	impl_->set_continuous_updates(enabled);
+}
+
+void client::set_request_pipeline_depth(int max_depth)
+{
+	impl_->pipeline_.set_max_depth(max_depth);
+}
+
+void client::set_auto_select(bool enabled)
+{
+	impl_->set_auto_select(enabled);
+}
+
+void client::set_decode_budget(std::chrono::milliseconds budget)
+{
+	impl_->set_decode_budget(budget);
+}
+
+void client::set_viewport(const std::vector<rect> &rects)
+{
+	impl_->set_viewport(rects);
+}
+
+void client::set_background_refresh(std::chrono::milliseconds interval)
+{
+	impl_->background_refresh_ms_ = static_cast<int>(std::max(interval, std::chrono::milliseconds::zero()).count());
+}
+
+void client::set_idle_backoff(std::chrono::milliseconds max_interval)
+{
+	impl_->set_idle_backoff(max_interval);
+}
+
+void client::set_max_fps(int fps)
+{
+	impl_->set_max_fps(fps);
+}
+
+void client::set_present_interval(std::chrono::milliseconds interval)
+{
+	impl_->present_interval_ms_ = static_cast<int>(std::max(interval, std::chrono::milliseconds::zero()).count());
+}
+
+void client::set_present_on_tick(bool enabled)
+{
+	impl_->set_present_on_tick(enabled);
+}
+
+void client::present_tick()
+{
+	impl_->present_tick();
+}
+
+void client::set_progressive_updates(std::chrono::milliseconds time_budget, std::size_t byte_budget)
+{
+	impl_->progressive_ms_ = static_cast<int>(std::max(time_budget, std::chrono::milliseconds::zero()).count());
+	impl_->progressive_bytes_ = byte_budget;
+}
+
+void client::set_fast_first_frame(bool enabled)
+{
+	impl_->fast_first_frame_ = enabled;
+}
+
+void client::set_lossless_refresh(bool enabled)
+{
+	impl_->lossless_refresh_ = enabled;
+}
+
+void client::set_pointer_coalescing(bool enabled)
+{
+	impl_->coalesce_pointer_ = enabled;
+}
+
+boost::asio::any_io_executor client::get_executor() const
+{
+	return impl_->strand_;
+}
+
+boost::asio::awaitable<error> client::async_next_frame(frame_update &update)
+{
+	/* the waiting runs on the strand, the caller resumes on its own executor */
+	co_return co_await boost::asio::co_spawn(
+		impl_->strand_,
+		[impl = impl_, &update]() -> boost::asio::awaitable<error> {
+			co_return co_await impl->co_next_frame(update);
+		},
+		boost::asio::use_awaitable);
+}
+
+boost::asio::awaitable<error> client::async_next_event(event &ev)
+{
+	co_return co_await boost::asio::co_spawn(
+		impl_->strand_,
+		[impl = impl_, &ev]() -> boost::asio::awaitable<error> { co_return co_await impl->co_next_event(ev); },
+		boost::asio::use_awaitable);
+}
+
+boost::asio::awaitable<bool> client::async_send_key(uint32_t key, bool down)
+{
+	co_return co_await boost::asio::co_spawn(
+		impl_->strand_, [impl = impl_, key, down]() -> boost::asio::awaitable<bool> {
+			co_return impl->send_key_event(key, down);
+		},
+		boost::asio::use_awaitable);
+}
+
+boost::asio::awaitable<bool> client::async_send_pointer(int x, int y, int button_mask)
+{
+	co_return co_await boost::asio::co_spawn(
+		impl_->strand_, [impl = impl_, x, y, button_mask]() -> boost::asio::awaitable<bool> {
+			co_return impl->send_pointer_event(x, y, button_mask);
+		},
+		boost::asio::use_awaitable);
+}
+
+void client::set_delegate_executor(const boost::asio::any_io_executor &executor)
+{
+	if (impl_->status_ != status::closed) {
+		spdlog::warn("The delegate executor can only be changed while the client is closed");
+		return;
+	}
+	impl_->handler_.set_dispatcher(executor ? std::make_shared<delegate_dispatcher>(executor) : nullptr);
+}
+
 const frame_buffer &client::frame() const
 {
 	return impl_->frame();
@@ -69,7 +208,7 @@ client::status client::current_status() const
 
 bool client::send_frame_encodings(const std::vector<std::string> &encodings)
 {
-	return impl_->send_frame_encodings(encodings);
+	return impl_->send_requested_encodings(encodings);
 }
 
 bool client::send_scale_setting(int scale)
@@ -147,6 +286,11 @@ int client::current_keyboard_led_state() const
 	return impl_->current_keyboard_led_state_;
 }
 
+uint64_t client::dropped_events() const
+{
+	return impl_->handler_.dropped();
+}
+
 int client::monitors() const
 {
 	return impl_->nbrMonitors_;
@@ -186,6 +330,11 @@ void client_delegate::on_bell()
 	return;
 }
 
+void client_delegate::on_frame_damage(const frame_buffer &frame, const region & /*damage*/)
+{
+	on_frame_update(frame);
+}
+
 void client_delegate::on_cursor_shape(int xhot, int yhot, const frame_buffer &rc_source, const uint8_t *rc_mask) {}
 
 void client_delegate::on_cursor_pos(int x, int y) {}
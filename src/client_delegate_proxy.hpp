@@ -1,17 +1,64 @@
 #pragma once
+#include "delegate_dispatcher.hpp"
 #include "libvnc-cpp/client.h"
-#include <shared_mutex>
+#include "spdlog/spdlog.h"
+#include <boost/asio/experimental/channel.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <optional>
+#include <thread>
+#include <utility>
 
 namespace libvnc {
+/** Forwards callbacks to the user's delegate, which can be swapped from any thread.
+    Callbacks are only invoked from the client's strand, so at most one is in flight
+    (plus any it nests). The hot path is a plain store to active_ and a load of the
+    delegate, with no lock word or read-modify-write; reset() publishes the new pointer
+    and waits until the callbacks that may have seen the old one have returned.
+
+    With a dispatcher set, notifications go through it to the application's executor;
+    callbacks whose answer the handshake needs still run inline. Once an event channel
+    is attached, every notification is also published to it for async_next_event(). */
 class client_delegate_proxy {
 public:
 	void reset(client_delegate *handler)
 	{
-		std::unique_lock<std::shared_mutex> lck(mutex_);
-		handler_ = handler;
+		handler_.store(handler);
+		if (dispatcher_)
+			dispatcher_->set_handler(handler);
+		/* swapping from inside one of our own callbacks must not wait for itself */
+		if (current_ != this) {
+			while (active_.load() != 0)
+				std::this_thread::yield();
+		}
+		if (dispatcher_)
+			dispatcher_->wait_idle();
+	}
+	/** Not synchronised with running callbacks; set it before the client starts. */
+	void set_dispatcher(std::shared_ptr<delegate_dispatcher> dispatcher)
+	{
+		if (dispatcher)
+			dispatcher->set_handler(handler_.load());
+		dispatcher_ = std::move(dispatcher);
+	}
+
+	using retention = delegate_dispatcher::retention;
+	using event_channel = boost::asio::experimental::channel<void(boost::system::error_code, client::event)>;
+	/** Only called on the strand, like the callbacks that publish to it. */
+	void set_event_channel(event_channel *events) { events_ = events; }
+
+	void on_connect(const error &ec)
+	{
+		publish({.kind = client::event::type::connect, .err = ec});
+		notify_as(retention::keep, client::event::type::connect, &client_delegate::on_connect, ec);
+	}
+	void on_disconnect(const error &ec)
+	{
+		publish({.kind = client::event::type::disconnect, .err = ec});
+		notify_as(retention::keep, client::event::type::disconnect, &client_delegate::on_disconnect, ec);
 	}
-	auto on_connect(const error &ec) { return invoke(&client_delegate::on_connect, ec); }
-	auto on_disconnect(const error &ec) { return invoke(&client_delegate::on_disconnect, ec); }
 
 	auto select_auth_scheme(const std::set<proto::rfbAuthScheme> &auths)
 	{
@@ -21,42 +68,166 @@ public:
 	auto get_auth_ms_account() { return invoke(&client_delegate::get_auth_ms_account); }
 
 	auto want_format() { return invoke(&client_delegate::want_format); }
-	auto on_new_frame_size(int w, int h) { return invoke(&client_delegate::on_new_frame_size, w, h); }
-	auto on_keyboard_led_state(int state) { return invoke(&client_delegate::on_keyboard_led_state, state); }
-	auto on_frame_update(const frame_buffer &frame) { return invoke(&client_delegate::on_frame_update, frame); }
-	auto on_bell() { return invoke(&client_delegate::on_bell); }
-	auto on_cut_text(std::string_view text) { return invoke(&client_delegate::on_cut_text, text); }
-	auto on_cut_text_utf8(std::string_view text) { return invoke(&client_delegate::on_cut_text_utf8, text); }
-	auto on_text_chat(const proto::rfbTextChatType &type, std::string_view message)
+	void on_new_frame_size(int w, int h)
+	{
+		publish({.kind = client::event::type::new_frame_size, .x = w, .y = h});
+		notify_as(retention::latest, client::event::type::new_frame_size, &client_delegate::on_new_frame_size,
+			  w, h);
+	}
+	void on_keyboard_led_state(int state)
+	{
+		publish({.kind = client::event::type::keyboard_led_state, .x = state});
+		notify(&client_delegate::on_keyboard_led_state, state);
+	}
+	void on_frame_update(const frame_buffer &frame)
+	{
+		region damage;
+		damage.add(rect{0, 0, frame.width(), frame.height()});
+		on_frame_damage(frame, damage);
+	}
+	void on_frame_damage(const frame_buffer &frame, const region &damage)
 	{
-		return invoke(&client_delegate::on_text_chat, type, message);
+		if (dispatcher_)
+			dispatcher_->post_frame(frame, damage);
+		else
+			invoke(&client_delegate::on_frame_damage, frame, damage);
 	}
-	auto on_cursor_shape(int xhot, int yhot, const frame_buffer &rc_source, const uint8_t *rc_mask)
+	void on_bell()
 	{
-		return invoke(&client_delegate::on_cursor_shape, xhot, yhot, rc_source, rc_mask);
+		publish({.kind = client::event::type::bell});
+		notify_as(retention::latest, client::event::type::bell, &client_delegate::on_bell);
+	}
+	void on_cut_text(std::string_view text)
+	{
+		publish({.kind = client::event::type::cut_text, .text = std::string(text)});
+		notify_as(retention::latest, client::event::type::cut_text, &client_delegate::on_cut_text,
+			  std::string(text));
+	}
+	void on_cut_text_utf8(std::string_view text)
+	{
+		publish({.kind = client::event::type::cut_text_utf8, .text = std::string(text)});
+		notify_as(retention::latest, client::event::type::cut_text_utf8, &client_delegate::on_cut_text_utf8,
+			  std::string(text));
+	}
+	void on_text_chat(const proto::rfbTextChatType &type, std::string_view message)
+	{
+		publish({.kind = client::event::type::text_chat, .text = std::string(message), .chat_type = type});
+		notify(&client_delegate::on_text_chat, type, std::string(message));
+	}
+	void on_cursor_shape(int xhot, int yhot, const frame_buffer &rc_source, const uint8_t *rc_mask)
+	{
+		if (dispatcher_)
+			dispatcher_->post_cursor_shape(xhot, yhot, rc_source, rc_mask);
+		else
+			invoke(&client_delegate::on_cursor_shape, xhot, yhot, rc_source, rc_mask);
+	}
+	void on_cursor_pos(int x, int y)
+	{
+		publish({.kind = client::event::type::cursor_pos, .x = x, .y = y});
+		if (dispatcher_)
+			dispatcher_->post_cursor_pos(x, y);
+		else
+			invoke(&client_delegate::on_cursor_pos, x, y);
+	}
+	void on_status_changed(const client::status &s)
+	{
+		publish({.kind = client::event::type::status_changed, .state = s});
+		notify_as(retention::latest, client::event::type::status_changed, &client_delegate::on_status_changed,
+			  s);
+	}
+	void on_monitor_info(int count)
+	{
+		publish({.kind = client::event::type::monitor_info, .x = count});
+		notify(&client_delegate::on_monitor_info, count);
+	}
+
+	/** notifications the dispatcher or the event channel had to drop */
+	std::uint64_t dropped() const
+	{
+		auto dropped = dropped_.load(std::memory_order_relaxed);
+		return dispatcher_ ? dropped + dispatcher_->dropped() : dropped;
+	}
+
+	/* Arguments are taken by value, so whatever the dispatcher queues owns its data. */
+	template<typename Func, typename... Args> void notify(Func func, Args... args)
+	{
+		notify_as(retention::droppable, {}, func, std::move(args)...);
+	}
+	/* the event type doubles as the tag that retention::latest merges on */
+	template<typename Func, typename... Args>
+	void notify_as(retention retain, client::event::type tag, Func func, Args... args)
+	{
+		if (!dispatcher_) {
+			invoke(func, args...);
+			return;
+		}
+		dispatcher_->post([func, ... args = std::move(args)](client_delegate &handler) {
+			std::invoke(func, handler, args...);
+		}, retain, static_cast<std::uint32_t>(tag));
 	}
-	auto on_cursor_pos(int x, int y) { return invoke(&client_delegate::on_cursor_pos, x, y); }
-	auto on_status_changed(const client::status &s) { return invoke(&client_delegate::on_status_changed, s); }
-	auto on_monitor_info(int count) { return invoke(&client_delegate::on_monitor_info, count); }
 
 	template<typename Func, typename... Args> auto invoke(Func func, Args &&...args)
 	{
 		using result_t = std::invoke_result_t<Func, client_delegate *, Args...>;
-		std::shared_lock lck(mutex_);
-		if (!handler_) {
+		call_guard guard(*this);
+		auto handler = handler_.load();
+		if (!handler) {
 			if constexpr (!std::is_void_v<result_t>)
 				return std::optional<result_t>{};
 			else
 				return;
 		}
 		if constexpr (!std::is_void_v<result_t>)
-			return std::optional<result_t>{std::invoke(func, handler_, std::forward<Args>(args)...)};
+			return std::optional<result_t>{std::invoke(func, handler, std::forward<Args>(args)...)};
 		else
-			std::invoke(func, handler_, std::forward<Args>(args)...);
+			std::invoke(func, handler, std::forward<Args>(args)...);
 	}
 
 private:
-	client_delegate *handler_ = nullptr;
-	std::shared_mutex mutex_;
+	void publish(client::event ev)
+	{
+		if (!events_)
+			return;
+		/* a full buffer means nobody keeps up with the channel; drop rather than stall the strand */
+		auto kind = ev.kind;
+		if (!events_->try_send(boost::system::error_code{}, std::move(ev))) {
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+			spdlog::debug("Event channel full, dropping event {}", static_cast<int>(kind));
+		}
+	}
+
+	/* Marks a callback in flight before the delegate is loaded. Both sides use sequentially
+	   consistent accesses, so either the callback sees the new delegate or reset() sees the
+	   callback. Only the strand writes active_, which is why a plain store is enough. */
+	class call_guard {
+	public:
+		explicit call_guard(client_delegate_proxy &proxy)
+			: proxy_(proxy)
+			, outer_(std::exchange(current_, &proxy))
+		{
+			proxy_.active_.store(proxy_.active_.load(std::memory_order_relaxed) + 1);
+		}
+		~call_guard()
+		{
+			proxy_.active_.store(proxy_.active_.load(std::memory_order_relaxed) - 1,
+					     std::memory_order_release);
+			current_ = outer_;
+		}
+		call_guard(const call_guard &) = delete;
+		call_guard &operator=(const call_guard &) = delete;
+
+	private:
+		client_delegate_proxy &proxy_;
+		const client_delegate_proxy *outer_;
+	};
+
+	/* the proxy whose callback this thread is running, if any */
+	static inline thread_local const client_delegate_proxy *current_ = nullptr;
+
+	std::atomic<client_delegate *> handler_ = nullptr;
+	std::atomic<uint32_t> active_ = 0;
+	std::shared_ptr<delegate_dispatcher> dispatcher_;
+	event_channel *events_ = nullptr;
+	std::atomic<std::uint64_t> dropped_ = 0;
 };
-} // namespace libvnc
\ No newline at end of file
+} // namespace libvnc
@@ -21,6 +21,7 @@
 #include "libvnc-cpp/error.h"
 #include "libvnc-cpp/proto.h"
 #include "use_awaitable.hpp"
+#include <boost/asio/bind_executor.hpp>
 #include <boost/asio/co_spawn.hpp>
 #include <boost/asio/connect.hpp>
 #include <boost/asio/detached.hpp>
@@ -84,26 +85,62 @@ static void vncEncryptBytes2(unsigned char *where, const int length, unsigned ch
 	}
 }
 
+/* quality of a fast first frame and how long the screen has to settle before a lossless refresh */
+static constexpr int first_frame_quality = 0;
+static constexpr auto refine_delay = std::chrono::seconds(1);
+
+/* input overtakes everything else queued; file data goes last, in chunks. Clipboard text travels
+   with the input, so the keystroke that pastes it can never arrive first. */
+static send_buffer::priority send_priority(proto::rfbClientToServerMsg id)
+{
+	switch (id) {
+	case proto::rfbKeyEvent:
+	case proto::rfbPointerEvent:
+	case proto::rfbQemuEvent:
+	case proto::rfbClientCutText:
+		return send_buffer::priority::input;
+	case proto::rfbFileTransfer:
+		return send_buffer::priority::bulk;
+	default:
+		return send_buffer::priority::control;
+	}
+}
+
+/* marks our own round trip probes among the fence replies */
+static constexpr std::array<uint8_t, 4> rtt_probe_payload = {'R', 'T', 'T', 'P'};
+
+/* async_next_event() buffers this many for a slow consumer, newer ones are dropped */
+static constexpr std::size_t max_buffered_events = 256;
+
 } // namespace detail
 
-client_impl::client_impl(const boost::asio::any_io_executor &executor) : strand_(executor), resolver_(executor)
-{
-	register_message(proto::rfbFramebufferUpdate, &client_impl::on_rfbFramebufferUpdate, this);
-	register_message(proto::rfbSetColourMapEntries, &client_impl::on_rfbSetColourMapEntries, this);
-	register_message(proto::rfbBell, &client_impl::on_rfbBell, this);
-	register_message(proto::rfbServerCutText, &client_impl::on_rfbServerCutText, this);
-	register_message(proto::rfbTextChat, &client_impl::on_rfbTextChat, this);
-	register_message(proto::rfbXvp, &client_impl::on_rfbXvp, this);
-	register_message(proto::rfbResizeFrameBuffer, &client_impl::on_rfbResizeFrameBuffer, this);
-	register_message(proto::rfbPalmVNCReSizeFrameBuffer, &client_impl::on_rfbPalmVNCReSizeFrameBuffer, this);
-	register_message(proto::rfbMonitorInfo, &client_impl::on_rfbMonitorInfo, this);
-	register_message(proto::rfbKeepAlive, &client_impl::on_rfbKeepAlive, this);
-
-	register_auth_message(proto::rfbNoAuth, &client_impl::on_rfbNoAuth, this);
-	register_auth_message(proto::rfbVncAuth, &client_impl::on_rfbVncAuth, this);
-	register_auth_message(proto::rfbUltraVNC, &client_impl::on_rfbUltraVNC, this);
-	register_auth_message(proto::rfbUltraMSLogonII, &client_impl::on_rfbUltraMSLogonII, this);
-	register_auth_message(proto::rfbClientInitExtraMsgSupport, &client_impl::on_rfbClientInitExtraMsgSupport, this);
+client_impl::client_impl(const boost::asio::any_io_executor &executor)
+	: strand_(executor)
+	, resolver_(executor)
+	, write_strand_(executor)
+	, request_timer_(strand_)
+	, present_timer_(strand_)
+	, frame_signal_(strand_)
+{
+	register_message(proto::rfbFramebufferUpdate, &client_impl::on_rfbFramebufferUpdate);
+	register_message(proto::rfbSetColourMapEntries, &client_impl::on_rfbSetColourMapEntries);
+	register_message(proto::rfbBell, &client_impl::on_rfbBell);
+	register_message(proto::rfbServerCutText, &client_impl::on_rfbServerCutText);
+	register_message(proto::rfbTextChat, &client_impl::on_rfbTextChat);
+	register_message(proto::rfbXvp, &client_impl::on_rfbXvp);
+	register_message(proto::rfbResizeFrameBuffer, &client_impl::on_rfbResizeFrameBuffer);
+	register_message(proto::rfbPalmVNCReSizeFrameBuffer, &client_impl::on_rfbPalmVNCReSizeFrameBuffer);
+	register_message(proto::rfbMonitorInfo, &client_impl::on_rfbMonitorInfo);
+	register_message(proto::rfbKeepAlive, &client_impl::on_rfbKeepAlive);
+	register_message(proto::rfbEndOfContinuousUpdates, &client_impl::on_rfbEndOfContinuousUpdates);
+	register_message(proto::rfbFence, &client_impl::on_rfbFence);
+	register_message(proto::rfbServerState, &client_impl::on_rfbServerState);
+
+	register_auth_message(proto::rfbNoAuth, &client_impl::on_rfbNoAuth);
+	register_auth_message(proto::rfbVncAuth, &client_impl::on_rfbVncAuth);
+	register_auth_message(proto::rfbUltraVNC, &client_impl::on_rfbUltraVNC);
+	register_auth_message(proto::rfbUltraMSLogonII, &client_impl::on_rfbUltraMSLogonII);
+	register_auth_message(proto::rfbClientInitExtraMsgSupport, &client_impl::on_rfbClientInitExtraMsgSupport);
 
 	register_encoding<encoding::zrle>();
 	register_encoding<encoding::tight>();
@@ -129,7 +166,9 @@ client_impl::client_impl(const boost::asio::any_io_executor &executor) : strand_
 
 const libvnc::frame_buffer &client_impl::frame() const
 {
-	return frame_;
+	if (converter_.is_identity())
+		return frame_;
+	return output_frame_;
 }
 
 void client_impl::close()
@@ -140,18 +179,45 @@ void client_impl::close()
 
 		resolver_.cancel();
 		if (auto s = stream_; s) {
+			/* shutdown only issues a syscall, so it may overlap a write being started on the
+			   writer strand; closing waits until the writer has let go of the stream */
 			boost::system::error_code ec;
-			stream_->shutdown(boost::asio::socket_base::shutdown_both, ec);
-			stream_->close(ec);
+			s->shutdown(boost::asio::socket_base::shutdown_both, ec);
+			if (writer_attached_)
+				detach_writer();
+			else
+				s->close(ec);
 		}
 		desktop_name_.clear();
 		current_keyboard_led_state_ = 0;
-		extendedClipboardServerCapabilities_.reset();
+		extendedClipboardServerCapabilities_ = 0;
 		nbrMonitors_ = 0;
 		ultra_server_ = false;
 		brfbClientInitExtraMsgSupportNew_ = false;
+		cu_supported_ = false;
+		cu_active_ = false;
+		cu_ending_ = false;
+		pipeline_.reset();
+		auto_select_.reset();
+		rtt_probe_sent_.reset();
+		decode_budget_.reset();
+		scheduler_.reset();
+		request_timer_.cancel();
+		request_timer_armed_ = false;
+		present_timer_.cancel();
+		present_timer_armed_ = false;
+		present_damage_.clear();
+		frame_signal_.cancel();
+		send_buffer_.clear();
+		first_frame_pending_ = false;
+		refining_ = false;
+		lossy_.clear();
+		refine_pending_.clear();
 
 		commit_status(client::status::closed);
+		/* a waiter is only pending while nothing is buffered, so no event is lost */
+		if (event_channel_)
+			event_channel_->cancel();
 	});
 }
 void client_impl::start()
@@ -220,15 +286,104 @@ boost::asio::awaitable<libvnc::error> client_impl::co_run()
 	co_return error{};
 }
 
-void client_impl::send_framebuffer_update_request(int x, int y, int w, int h, bool incremental)
+bool client_impl::send_update_request_msg(const rect &r, bool incremental)
 {
 	proto::rfbFramebufferUpdateRequestMsg msg{};
-	msg.x = x;
-	msg.y = y;
-	msg.w = w;
-	msg.h = h;
+	msg.x = r.x;
+	msg.y = r.y;
+	msg.w = r.w;
+	msg.h = r.h;
 	msg.incremental = incremental;
-	send_msg_to_server(proto::rfbFramebufferUpdateRequest, &msg, sizeof(msg));
+	return send_msg_to_server(proto::rfbFramebufferUpdateRequest, &msg, sizeof(msg));
+}
+
+void client_impl::send_framebuffer_update_request(int x, int y, int w, int h, bool incremental)
+{
+	if (send_update_request_msg(rect{x, y, w, h}, incremental)) {
+		pipeline_.on_request_sent();
+		last_request_ = std::chrono::steady_clock::now();
+	}
+}
+
+void client_impl::send_viewport_request(bool incremental)
+{
+	auto rects = viewport_rects();
+	if (rects.empty()) {
+		send_framebuffer_update_request(incremental);
+		return;
+	}
+
+	/* the server answers the whole batch with one update, so it counts as one request */
+	bool sent = false;
+	for (const auto &r : rects)
+		sent |= send_update_request_msg(r, incremental);
+	if (sent) {
+		pipeline_.on_request_sent();
+		last_request_ = std::chrono::steady_clock::now();
+	}
+}
+
+std::vector<rect> client_impl::viewport_rects() const
+{
+	std::vector<rect> rects;
+	rect whole{0, 0, frame_.width(), frame_.height()};
+	for (const auto &r : viewport_) {
+		if (auto clipped = r.intersected(whole); !clipped.empty())
+			rects.push_back(clipped);
+	}
+	/* a viewport covering everything is the same as none */
+	if (rects.size() == 1 && rects.front().contains(whole))
+		rects.clear();
+	return rects;
+}
+
+bool client_impl::background_refresh_due()
+{
+	auto interval = std::chrono::milliseconds(background_refresh_ms_.load());
+	if (interval.count() <= 0)
+		return false;
+
+	auto now = std::chrono::steady_clock::now();
+	if (now - last_background_refresh_ < interval)
+		return false;
+	last_background_refresh_ = now;
+	return true;
+}
+
+void client_impl::set_viewport(std::vector<rect> rects)
+{
+	boost::asio::dispatch(strand_, [this, self = shared_from_this(), rects = std::move(rects)]() mutable {
+		apply_viewport(std::move(rects), std::nullopt);
+	});
+}
+
+void client_impl::apply_viewport(std::vector<rect> rects, std::optional<uint32_t> screen_id)
+{
+	viewport_ = std::move(rects);
+	viewport_screen_ = screen_id;
+	last_background_refresh_ = std::chrono::steady_clock::now();
+	if (status_ != client::status::connected)
+		return;
+
+	/* parts that just became visible may be stale, ask for them in full */
+	if (cu_active_)
+		send_enable_continuous_updates(true);
+	send_viewport_request(false);
+}
+
+void client_impl::select_viewport_screen(std::optional<uint32_t> screen_id)
+{
+	std::vector<rect> rects;
+	if (screen_id) {
+		auto iter = std::ranges::find_if(screens_, [&](const auto &s) { return s.id.value() == *screen_id; });
+		if (iter == screens_.end()) {
+			screen_id.reset();
+		} else {
+			rects.push_back(
+				rect{iter->x.value(), iter->y.value(), iter->width.value(), iter->height.value()});
+		}
+	}
+	apply_viewport(std::move(rects), screen_id);
 }
 
 void client_impl::send_framebuffer_update_request(bool incremental)
@@ -236,6 +391,70 @@ void client_impl::send_framebuffer_update_request(bool incremental)
 	return send_framebuffer_update_request(0, 0, frame_.width(), frame_.height(), incremental);
 }
 
+void client_impl::request_updates(int depth)
+{
+	/* with continuous updates the server pushes updates on its own */
+	if (cu_active_ || cu_ending_ || request_timer_armed_)
+		return;
+
+	/* a throttled client asks for one update at a time, no sooner than the interval allows */
+	if (auto interval = request_interval(); interval.count() > 0) {
+		if (pipeline_.outstanding() > 0)
+			return;
+		auto due = last_request_ + interval;
+		if (due > std::chrono::steady_clock::now()) {
+			request_timer_armed_ = true;
+			request_timer_.expires_at(due);
+			request_timer_.async_wait([this, self = shared_from_this()](boost::system::error_code ec) {
+				/* whoever cancels the timer also clears the flag */
+				if (ec == boost::asio::error::operation_aborted)
+					return;
+				request_timer_armed_ = false;
+				if (status_ == client::status::connected)
+					request_updates(1);
+			});
+			return;
+		}
+		depth = 1;
+	}
+
+	for (int i = pipeline_.outstanding(); i < depth; ++i)
+		send_viewport_request(true);
+}
+
+std::chrono::steady_clock::duration client_impl::request_interval() const
+{
+	return std::max(
+		{decode_budget_.min_request_interval(), scheduler_.idle_interval(), scheduler_.frame_interval()});
+}
+
+void client_impl::note_input()
+{
+	if (!scheduler_.on_input())
+		return;
+
+	/* the user is back, don't leave them waiting for the idle interval to run out */
+	boost::asio::dispatch(strand_, [this, self = shared_from_this()]() {
+		if (request_timer_armed_) {
+			request_timer_.cancel();
+			request_timer_armed_ = false;
+		}
+		if (status_ == client::status::connected)
+			request_updates(1);
+	});
+}
+
+void client_impl::set_idle_backoff(std::chrono::steady_clock::duration max_interval)
+{
+	scheduler_.set_max_idle_interval(max_interval);
+}
+
+void client_impl::set_max_fps(int fps)
+{
+	scheduler_.set_max_fps(fps);
+	boost::asio::dispatch(strand_, [this, self = shared_from_this()]() { apply_continuous_updates(); });
+}
+
 std::vector<std::string> client_impl::supported_frame_encodings() const
 {
 	std::vector<std::string> encs;
@@ -247,13 +466,54 @@ std::vector<std::string> client_impl::supported_frame_encodings() const
 	return encs;
 }
 
+bool client_impl::send_requested_encodings(const std::vector<std::string> &encodings)
+{
+	{
+		std::lock_guard lck(requested_encodings_mutex_);
+		requested_encodings_ = encodings;
+	}
+	/* the automatic adjustments it applies are strand state */
+	boost::asio::dispatch(strand_, [this, self = shared_from_this()]() {
+		send_frame_encodings(preferred_frame_encodings());
+	});
+	return supported_messages_.test_client2server(proto::rfbSetEncodings);
+}
+
+std::vector<std::string> client_impl::preferred_frame_encodings() const
+{
+	std::vector<std::string> encodings;
+	{
+		std::lock_guard lck(requested_encodings_mutex_);
+		encodings = requested_encodings_;
+	}
+	/* the adjustments below only reorder, so they stay within what the application asked for */
+	if (encodings.empty())
+		encodings = supported_frame_encodings();
+	if (const auto &settings = auto_select_.current(); settings && auto_select_enabled_) {
+		if (auto iter = std::ranges::find(encodings, settings->encoding); iter != encodings.end())
+			std::rotate(encodings.begin(), iter, iter + 1);
+	}
+	/* decoding cost outranks the link estimate: a client that cannot keep up gains nothing from fewer bytes */
+	if (auto cheap = decode_budget_.preferred_encoding(); !cheap.empty()) {
+		if (auto iter = std::ranges::find(encodings, cheap); iter != encodings.end())
+			std::rotate(encodings.begin(), iter, iter + 1);
+	}
+	/* only Tight carries JPEG */
+	if (first_frame_pending_) {
+		if (auto iter = std::ranges::find(encodings, "tight"); iter != encodings.end())
+			std::rotate(encodings.begin(), iter, iter + 1);
+	}
+	return encodings;
+}
+
 bool client_impl::send_pointer_event(int x, int y, int buttonMask)
 {
 	proto::rfbPointerEventMsg pe{};
 	pe.buttonMask = buttonMask;
 	pe.x = std::max(x, 0);
 	pe.y = std::max(y, 0);
-	return send_msg_to_server(proto::rfbPointerEvent, &pe, sizeof(pe));
+	note_input();
+	return send_input_msg(proto::rfbPointerEvent, &pe, sizeof(pe));
 }
 
 bool client_impl::send_client_cut_text(std::string_view text)
@@ -268,7 +528,7 @@ bool client_impl::send_client_cut_text(std::string_view text)
 
 bool client_impl::send_client_cut_text_utf8(std::string_view text)
 {
-	if (!extendedClipboardServerCapabilities_.any())
+	if (extendedClipboardServerCapabilities_ == 0)
 		return false;
 #if defined(LIBVNC_HAVE_LIBZ)
 	boost::endian::big_uint32_buf_t flags{};
@@ -356,18 +616,152 @@ bool client_impl::send_set_monitor(uint8_t nbr)
 	mm.pad2 = 0;
 	mm.pad3 = 0;
 	mm.nbr = nbr;
+
+	/* without SetMonitor the server keeps sending the whole desktop, so only the
+	   selected ExtDesktopSize screen is requested instead. nbr 0 selects all of them. */
+	if (!supported_messages_.test_client2server(proto::rfbSetMonitor)) {
+		boost::asio::dispatch(strand_, [this, self = shared_from_this(), nbr]() {
+			if (nbr == 0 || nbr > screens_.size())
+				select_viewport_screen(std::nullopt);
+			else
+				select_viewport_screen(screens_[nbr - 1].id.value());
+		});
+		return true;
+	}
+
 	if (nbr <= nbrMonitors_) {
+		/* the server resizes the frame to the selected monitor */
+		set_viewport({});
 		return send_msg_to_server(proto::rfbSetMonitor, &mm, sizeof(mm));
 	}
 	return false;
 }
 
+void client_impl::set_continuous_updates(bool enabled)
+{
+	continuous_updates_ = enabled;
+	boost::asio::dispatch(strand_, [this, self = shared_from_this()]() { apply_continuous_updates(); });
+}
+
+void client_impl::apply_continuous_updates()
+{
+	if (!cu_supported_ || cu_ending_ || status_ != client::status::connected)
+		return;
+
+	if (want_continuous_updates() && !cu_active_) {
+		cu_active_ = send_enable_continuous_updates(true);
+		if (cu_active_)
+			pipeline_.reset();
+	} else if (!want_continuous_updates() && cu_active_) {
+		/* updates may still arrive until the server confirms with EndOfContinuousUpdates */
+		cu_active_ = false;
+		cu_ending_ = send_enable_continuous_updates(false);
+		if (!cu_ending_)
+			request_updates(1);
+	}
+}
+
+void client_impl::set_auto_select(bool enabled)
+{
+	auto_select_enabled_ = enabled;
+	boost::asio::dispatch(strand_, [this, self = shared_from_this()]() { auto_select_.reset(); });
+}
+
+void client_impl::apply_auto_select(std::uint64_t bytes, std::chrono::steady_clock::duration wait)
+{
+	/* without fences the quickest request turnaround is the best round trip estimate we have */
+	if (!supported_messages_.test_client2server(proto::rfbFence) && pipeline_.min_latency().count() > 0)
+		auto_select_.on_rtt(pipeline_.min_latency());
+
+	auto_select_.on_update(bytes, wait);
+	if (!auto_select_enabled_)
+		return;
+
+	auto settings = auto_select_.poll();
+	if (!settings)
+		return;
+
+	spdlog::info("Auto select: {} compress {} quality {} ({} kbit/s, rtt {} us)", settings->encoding,
+		     settings->compress_level, settings->quality_level, auto_select_.kbits_per_second(),
+		     std::chrono::duration_cast<std::chrono::microseconds>(auto_select_.rtt()).count());
+
+	compress_level_ = settings->compress_level;
+	quality_level_ = settings->quality_level;
+	send_frame_encodings(preferred_frame_encodings());
+}
+
+void client_impl::set_decode_budget(std::chrono::steady_clock::duration budget)
+{
+	decode_budget_.set_budget(budget);
+}
+
+void client_impl::apply_decode_budget()
+{
+	spdlog::info("Decode budget: step {} (decode {} us, quality cap {}, request interval {} ms)",
+		     decode_budget_.step(),
+		     std::chrono::duration_cast<std::chrono::microseconds>(pipeline_.decode_time()).count(),
+		     decode_budget_.quality_cap(),
+		     std::chrono::duration_cast<std::chrono::milliseconds>(decode_budget_.min_request_interval())
+			     .count());
+
+	send_frame_encodings(preferred_frame_encodings());
+	apply_continuous_updates();
+}
+
+void client_impl::send_rtt_probe()
+{
+	if (rtt_probe_sent_ || !supported_messages_.test_client2server(proto::rfbFence))
+		return;
+
+	/* BlockBefore makes the server answer only after it has processed everything we sent,
+	   so the reply measures the whole round trip */
+	if (send_fence(proto::rfbFenceFlagRequest | proto::rfbFenceFlagBlockBefore,
+		       std::span<const uint8_t>(detail::rtt_probe_payload)))
+		rtt_probe_sent_ = std::chrono::steady_clock::now();
+}
+
+bool client_impl::want_continuous_updates() const
+{
+	/* pushed updates cannot be slowed down, so a throttled or capped client goes back to requesting */
+	return continuous_updates_ && decode_budget_.min_request_interval().count() == 0 &&
+	       scheduler_.frame_interval().count() == 0;
+}
+
+bool client_impl::send_enable_continuous_updates(bool enable)
+{
+	proto::rfbEnableContinuousUpdatesMsg msg{};
+	/* the extension takes a single area, so a viewport of several rects is sent as its bounds */
+	region area;
+	for (const auto &r : viewport_rects())
+		area.add(r);
+	auto bounds = area.empty() ? rect{0, 0, frame_.width(), frame_.height()} : area.bounds();
+
+	msg.enable = enable ? 1 : 0;
+	msg.x = bounds.x;
+	msg.y = bounds.y;
+	msg.w = bounds.w;
+	msg.h = bounds.h;
+	return send_msg_to_server(proto::rfbEnableContinuousUpdates, &msg, sizeof(msg));
+}
+
+bool client_impl::send_fence(uint32_t flags, std::span<const uint8_t> payload)
+{
+	proto::rfbFenceMsg msg{};
+	msg.pad1 = 0;
+	msg.pad2 = 0;
+	msg.flags = flags;
+	msg.length = static_cast<uint8_t>(payload.size());
+	return send_msg_to_server_buffers(proto::rfbFence, boost::asio::buffer(&msg, sizeof(msg)),
+					  boost::asio::buffer(payload.data(), payload.size()));
+}
+
 bool client_impl::send_key_event(uint32_t key, bool down)
 {
 	proto::rfbKeyEventMsg ke{};
 	ke.down = down ? 1 : 0;
 	ke.key = key;
-	return send_msg_to_server(proto::rfbKeyEvent, &ke, sizeof(ke));
+	note_input();
+	return send_input_msg(proto::rfbKeyEvent, &ke, sizeof(ke));
 }
 
 bool client_impl::send_extended_key_event(uint32_t keysym, uint32_t keycode, bool down)
@@ -377,7 +771,8 @@ bool client_impl::send_extended_key_event(uint32_t keysym, uint32_t keycode, boo
 	ke.down = down;
 	ke.keysym = keysym;
 	ke.keycode = keycode;
-	return send_msg_to_server(proto::rfbQemuEvent, &ke, sizeof(ke));
+	note_input();
+	return send_input_msg(proto::rfbQemuEvent, &ke, sizeof(ke));
 }
 
 boost::asio::awaitable<error> client_impl::async_connect_rfbserver()
@@ -441,6 +836,7 @@ boost::asio::awaitable<error> client_impl::async_connect_rfbserver()
 		spdlog::error("Failed to connect rfbserver [{}:{}] : {}", host_, port_, ec.message());
 		co_return err;
 	}
+	attach_writer();
 	co_return error{};
 }
 
@@ -566,7 +962,7 @@ boost::asio::awaitable<error> client_impl::async_authenticate()
 					    fmt::format("Unimplemented authentication method: {}! ",
 							(int)selected_auth_scheme));
 	}
-	co_return co_await iter->second();
+	co_return co_await (this->*iter->second)();
 }
 
 boost::asio::awaitable<error> client_impl::async_client_init()
@@ -617,12 +1013,25 @@ boost::asio::awaitable<error> client_impl::async_client_init()
 	int height = si.framebufferHeight.value();
 
 	handler_.on_new_frame_size(width, height);
-	if (auto format = handler_.want_format(); format && send_format(*format)) {
-		frame_.init(width, height, *format);
+
+	proto::rfbPixelFormat output_format = si.format;
+	if (auto format = handler_.want_format(); format)
+		output_format = *format;
+
+	auto wire_format = negotiate_wire_format(si.format, output_format);
+	converter_.set_formats(wire_format, output_format);
+	frame_.init(width, height, wire_format);
+	if (converter_.is_identity()) {
+		output_frame_.init(0, 0, output_format);
 	} else {
-		frame_.init(width, height, si.format);
+		spdlog::info("Converting pixels locally from the wire format:");
+		wire_format.print();
+		output_frame_.init(width, height, output_format);
 	}
-	send_frame_encodings(supported_frame_encodings());
+	damage_.clear();
+	pipeline_.reset();
+	first_frame_pending_ = fast_first_frame_.load();
+	send_frame_encodings(preferred_frame_encodings());
 
 	co_return error{};
 }
@@ -645,6 +1054,40 @@ boost::asio::awaitable<error> client_impl::async_send_client_init_extra_msg()
 	co_return error{};
 }
 
+proto::rfbPixelFormat client_impl::negotiate_wire_format(const proto::rfbPixelFormat &server_format,
+							   const proto::rfbPixelFormat &output_format)
+{
+	bool can_convert = pixel::converter::is_supported(output_format) && output_format.trueColour.value();
+
+	if (wire_format_ == client::wire_format::server_native && can_convert &&
+	    pixel::converter::is_supported(server_format))
+		return server_format;
+
+	/* SetPixelFormat has no reply, the server has to take whatever is sent. Only a client
+	   that cannot send it at all stays with the server's format. */
+	if (!supported_messages_.test_client2server(proto::rfbSetPixelFormat))
+		return server_format;
+
+	auto wanted = output_format;
+	if (can_convert) {
+		switch (wire_format_.load()) {
+		case client::wire_format::indexed8:
+			wanted = pixel::converter::colour_map_format();
+			break;
+		case client::wire_format::bgr233:
+			wanted = pixel::converter::bgr233_format();
+			break;
+		case client::wire_format::rgb565:
+			wanted = pixel::converter::rgb565_format();
+			break;
+		default:
+			break;
+		}
+	}
+	send_format(wanted);
+	return wanted;
+}
+
 bool client_impl::send_format(const proto::rfbPixelFormat &format)
 {
 	proto::rfbSetPixelFormatMsg spf{};
@@ -658,27 +1101,33 @@ bool client_impl::send_frame_encodings(const std::vector<std::string> &encodings
 {
 	std::vector<boost::endian::big_uint32_buf_t> encs;
 
-	auto apply_codecs = codecs_ | std::views::filter([&](const auto &enc) {
-				    if (!enc->is_frame_codec())
-					    return true;
-
-				    auto iter = std::ranges::find_if(encodings, [&](const auto &enc_name) {
-					    return enc->codec_name() == enc_name;
-				    });
-				    return iter != encodings.end();
-			    });
+	/* frame codecs go out in the caller's order of preference */
+	for (const auto &enc_name : encodings) {
+		auto iter = std::ranges::find_if(codecs_, [&](const auto &enc) {
+			return enc->is_frame_codec() && enc->codec_name() == enc_name;
+		});
+		if (iter != codecs_.end())
+			encs.emplace_back((*iter)->encoding_code());
+	}
 
-	for (const auto &codec : apply_codecs)
+	for (const auto &codec : codecs_ | std::views::filter([](const auto &enc) { return !enc->is_frame_codec(); }))
 		encs.emplace_back(codec->encoding_code());
 
+	int quality_level = std::min<int>(quality_level_, decode_budget_.quality_cap());
+	if (first_frame_pending_)
+		quality_level = std::min(quality_level, detail::first_frame_quality);
 	encs.emplace_back(compress_level_ + proto::rfbEncodingCompressLevel0);
-	encs.emplace_back(quality_level_ + proto::rfbEncodingQualityLevel0);
+	if (!refining_)
+		encs.emplace_back(quality_level + proto::rfbEncodingQualityLevel0);
 	encs.emplace_back(proto::rfbEncodingLastRect);
 #ifdef LIBVNC_HAVE_LIBZ
 	encs.emplace_back(proto::rfbEncodingExtendedClipboard);
 #endif
 	encs.emplace_back(proto::rfbEncodingMonitorInfo);
 	encs.emplace_back(proto::rfbEncodingEnableKeepAlive);
+	encs.emplace_back(proto::rfbEncodingEnableIdleTime);
+	encs.emplace_back(proto::rfbEncodingContinuousUpdates);
+	encs.emplace_back(proto::rfbEncodingFence);
 
 	proto::rfbSetEncodingsMsg msg{};
 	msg.pad = 0;
@@ -719,6 +1168,18 @@ bool client_impl::send_ext_desktop_size(const std::vector<proto::rfbExtDesktopSc
 	return send_msg_to_server_buffers(proto::rfbSetDesktopSize, boost::asio::buffer(&sdm, sizeof(sdm)), screens);
 }
 
+encoding::codec *client_impl::find_codec(proto::rfbEncoding encoding)
+{
+	if (last_codec_.second != nullptr && last_codec_.first == encoding)
+		return last_codec_.second;
+
+	auto iter = std::ranges::lower_bound(codec_index_, encoding, {}, &codec_entry::first);
+	if (iter == codec_index_.end() || iter->first != encoding)
+		return nullptr;
+	last_codec_ = *iter;
+	return iter->second;
+}
+
 boost::asio::awaitable<error> client_impl::server_message_loop()
 {
 	boost::system::error_code ec;
@@ -729,15 +1190,15 @@ boost::asio::awaitable<error> client_impl::server_message_loop()
 		if (ec)
 			co_return error::make_error(ec);
 
-		auto iter = message_map_.find(msg_id);
-		if (iter == message_map_.end()) {
+		auto handler = message_map_[msg_id];
+		if (handler == nullptr) {
 			spdlog::error("Unknown message type {} from VNC server", (int)msg_id);
 			co_return error::make_error(
 				boost::system::errc::make_error_code(boost::system::errc::wrong_protocol_type));
 		}
 
 		try {
-			if (auto err = co_await iter->second(); err)
+			if (auto err = co_await (this->*handler)(); err)
 				co_return err;
 
 		} catch (const std::exception &e) {
@@ -762,6 +1223,13 @@ boost::asio::awaitable<error> client_impl::server_keepalive_loop()
 
 		if (supported_messages_.test_client2server(proto::rfbKeepAlive))
 			send_msg_to_server_buffers(proto::rfbKeepAlive);
+		send_rtt_probe();
+
+		/* outside the viewport changes are only picked up from here. The request is not
+		   counted: the server folds it into whatever update it sends next. */
+		if (status_ == client::status::connected && !viewport_rects().empty() && background_refresh_due())
+			send_update_request_msg(rect{0, 0, frame_.width(), frame_.height()}, true);
+		refine_lossy();
 	}
 	co_return error{};
 }
@@ -835,48 +1303,150 @@ bool client_impl::send_msg_to_server(const proto::rfbClientToServerMsg &ID, cons
 }
 
 bool client_impl::send_msg_to_server_buffers(const proto::rfbClientToServerMsg &ID,
-					     const std::vector<boost::asio::const_buffer> &buffers)
+					     std::span<const boost::asio::const_buffer> buffers)
+{
+	if (!supported_messages_.test_client2server(ID)) {
+		spdlog::warn("Unsupported client2server protocol: {}", (int)ID);
+		return false;
+	}
+
+	auto prio = detail::send_priority(ID);
+	bool start_write = false;
+	if (prio == send_buffer::priority::input) {
+		/* input-class messages from here (clipboard text) go behind events still in the ring */
+		std::lock_guard lck(input_drain_mutex_);
+		start_write = move_input_to_send_buffer();
+		start_write |= send_buffer_.append(ID, buffers, prio);
+	} else {
+		start_write = send_buffer_.append(ID, buffers, prio);
+	}
+	/* only the first message after the last write has to wake the writer */
+	if (start_write)
+		boost::asio::dispatch(write_strand_, [this, self = shared_from_this()]() { flush_send_buffer(); });
+	return true;
+}
+
+bool client_impl::send_input_msg(const proto::rfbClientToServerMsg &ID, const void *data, std::size_t len)
 {
 	if (!supported_messages_.test_client2server(ID)) {
 		spdlog::warn("Unsupported client2server protocol: {}", (int)ID);
 		return false;
 	}
-	std::vector<uint8_t> buffer(boost::asio::buffer_size(buffers) + sizeof(ID));
-	std::memcpy(buffer.data(), &ID, sizeof(ID));
-	boost::asio::buffer_copy(boost::asio::buffer(buffer.data() + sizeof(ID), buffer.size() - sizeof(ID)), buffers);
 
-	send_raw_data(std::move(buffer));
+	input_record record{ID, static_cast<uint8_t>(len), {}};
+	if (len <= record.data.size()) {
+		std::memcpy(record.data.data(), data, len);
+		if (input_ring_.push(record)) {
+			if (!input_drain_scheduled_.exchange(true)) {
+				boost::asio::dispatch(write_strand_,
+						      [this, self = shared_from_this()]() { drain_input(); });
+			}
+			return true;
+		}
+	}
+
+	/* too big for a record, or the writer is far behind: move everything queued so far into
+	   the send buffer first, so this event cannot overtake older ones and leave a key held */
+	std::lock_guard lck(input_drain_mutex_);
+	bool start_write = move_input_to_send_buffer();
+	std::array<boost::asio::const_buffer, 1> body{boost::asio::buffer(data, len)};
+	start_write |= send_buffer_.append(ID, body, send_buffer::priority::input);
+	if (start_write)
+		boost::asio::dispatch(write_strand_, [this, self = shared_from_this()]() { flush_send_buffer(); });
 	return true;
 }
 
-void client_impl::send_raw_data(std::vector<uint8_t> &&data)
+void client_impl::drain_input()
 {
-	boost::asio::dispatch(strand_, [this, self = shared_from_this(), data = std::move(data)]() {
-		if (!stream_ && stream_->is_open())
-			return;
+	/* cleared first, so events pushed while draining schedule the next batch */
+	input_drain_scheduled_ = false;
+
+	std::unique_lock lck(input_drain_mutex_);
+	bool start_write = move_input_to_send_buffer();
+	lck.unlock();
+	if (start_write)
+		flush_send_buffer();
+}
 
-		bool write_in_proccess = !send_que_.empty();
-		send_que_.push_back(std::move(data));
-		if (write_in_proccess)
+bool client_impl::move_input_to_send_buffer()
+{
+	bool start_write = false;
+	bool coalesce = coalesce_pointer_;
+	while (auto record = input_ring_.pop()) {
+		std::array<boost::asio::const_buffer, 1> body{boost::asio::buffer(record->data.data(), record->length)};
+
+		/* moves with the same buttons held replace each other while they wait for the socket;
+		   a button change gets a different tag, and any other message in between ends the run */
+		uint32_t merge_tag = 0;
+		if (coalesce && record->id == proto::rfbPointerEvent)
+			merge_tag = 0x100 | record->data[0];
+		start_write |= send_buffer_.append(record->id, body, send_buffer::priority::input, merge_tag);
+	}
+	return start_write;
+}
+
+void client_impl::flush_send_buffer()
+{
+	auto data = send_buffer_.take();
+	if (data.empty())
+		return;
+
+	auto stream = write_stream_;
+	if (!stream) {
+		send_buffer_.abort();
+		return;
+	}
+
+	/* one write for everything queued since the last one; the buffer stays put until it completes,
+	   and the handler keeps the stream alive even if the connection is replaced meanwhile */
+	auto on_written = [this, self = shared_from_this(), stream](boost::system::error_code ec, std::size_t) {
+		if (ec) {
+			send_buffer_.abort();
 			return;
+		}
+		flush_send_buffer();
+	};
+	if (!write_tls_) {
+		boost::asio::async_write(*stream, boost::asio::buffer(data.data(), data.size()),
+					 boost::asio::bind_executor(write_strand_, std::move(on_written)));
+		return;
+	}
 
-		boost::asio::co_spawn(
-			strand_,
-			[this, self = shared_from_this()]() -> boost::asio::awaitable<void> {
-				while (!send_que_.empty()) {
-					const auto &buffer = send_que_.front();
-
-					boost::system::error_code ec;
-					co_await boost::asio::async_write(*stream_, boost::asio::buffer(buffer),
-									  net_awaitable[ec]);
-					if (ec) {
-						send_que_.clear();
-						co_return;
-					}
-					send_que_.pop_front();
-				}
-			},
-			boost::asio::detached);
+	/* the SSL engine is driven by the reads on strand_, so the write has to run there too */
+	boost::asio::dispatch(strand_, [this, stream, data, on_written = std::move(on_written)]() mutable {
+		boost::asio::async_write(
+			*stream, boost::asio::buffer(data.data(), data.size()),
+			boost::asio::bind_executor(
+				strand_, [this, on_written = std::move(on_written)](boost::system::error_code ec,
+										      std::size_t n) mutable {
+					boost::asio::dispatch(write_strand_,
+							      [on_written = std::move(on_written), ec, n]() mutable {
+								      on_written(ec, n);
+							      });
+				}));
+	});
+}
+
+void client_impl::attach_writer()
+{
+	writer_attached_ = true;
+	boost::asio::dispatch(write_strand_, [this, self = shared_from_this(), stream = stream_, tls = use_ssl_]() {
+		write_stream_ = stream;
+		write_tls_ = tls;
+	});
+}
+
+void client_impl::detach_writer()
+{
+	writer_attached_ = false;
+	boost::asio::dispatch(write_strand_, [this, self = shared_from_this(), stream = stream_]() {
+		if (write_stream_ == stream)
+			write_stream_.reset();
+		/* no write can be started on it any more; close it where the reads are started */
+		boost::asio::dispatch(strand_, [stream]() {
+			boost::system::error_code ec;
+			stream->close(ec);
+		});
 	});
 }
 
@@ -906,7 +1476,13 @@ void client_impl::soft_cursor_lock_area(int x, int y, int w, int h) {}
 
 void client_impl::got_cursor_shape(int xhot, int yhot, const frame_buffer &rc_source, const uint8_t *rc_mask)
 {
-	handler_.on_cursor_shape(xhot, yhot, rc_source, rc_mask);
+	if (converter_.is_identity()) {
+		handler_.on_cursor_shape(xhot, yhot, rc_source, rc_mask);
+		return;
+	}
+	cursor_frame_.init(rc_source.width(), rc_source.height(), converter_.dst_format());
+	converter_.convert(rc_source, cursor_frame_, rect{0, 0, rc_source.width(), rc_source.height()});
+	handler_.on_cursor_shape(xhot, yhot, cursor_frame_, rc_mask);
 }
 
 void client_impl::handle_cursor_pos(int x, int y)
@@ -938,13 +1514,30 @@ void client_impl::handle_ext_desktop_screen(const std::vector<proto::rfbExtDeskt
 {
 	screens_ = screens;
 	supported_messages_.set_client2server(proto::rfbSetDesktopSize);
+
+	/* follow the selected screen when the layout changes */
+	if (viewport_screen_)
+		select_viewport_screen(viewport_screen_);
+}
+
+void client_impl::handle_lossy_rect(int x, int y, int w, int h)
+{
+	rect_lossy_.add(rect{x, y, w, h});
 }
 
 void client_impl::handle_resize_client_buffer(int width, int height)
 {
 	handler_.on_new_frame_size(width, height);
 	frame_.set_size(width, height);
-
+	if (!converter_.is_identity())
+		output_frame_.set_size(width, height);
+	damage_.clear();
+	present_damage_.clear();
+	lossy_.clear();
+	refine_pending_.clear();
+
+	if (cu_active_)
+		send_enable_continuous_updates(true);
 	send_framebuffer_update_request(false);
 	spdlog::info("Got new framebuffer size: {}x{}", width, height);
 }
@@ -1047,6 +1640,17 @@ boost::asio::awaitable<libvnc::error> client_impl::on_rfbFramebufferUpdate()
 	if (ec)
 		co_return error::make_error(ec);
 
+	auto bytes_read = stream_->bytes_read();
+	auto read_wait = stream_->read_wait();
+	auto partial_bytes = bytes_read;
+	auto partial_time = std::chrono::steady_clock::now();
+	std::size_t damaged_area = 0;
+
+	/* keep the pipeline full while this update is decoded */
+	pipeline_.on_update_begin();
+	if (int depth = pipeline_.target_depth(); depth > 1)
+		request_updates(depth);
+
 	for (int i = 0; i < msg.num_rects.value(); ++i) {
 		co_await boost::asio::async_read(*stream_, boost::asio::buffer(&UpdateRect, sizeof(UpdateRect)),
 						 net_awaitable[ec]);
@@ -1057,26 +1661,207 @@ boost::asio::awaitable<libvnc::error> client_impl::on_rfbFramebufferUpdate()
 		if (encoding == proto::rfbEncodingLastRect)
 			break;
 
-		auto iter = std::ranges::find_if(codecs_,
-						 [&](const auto &codec) { return codec->encoding_code() == encoding; });
-		if (iter == codecs_.end()) {
+		auto codec = find_codec(encoding);
+		if (codec == nullptr) {
 			co_return error::make_error(custom_error::frame_error,
 						    fmt::format("Unsupported encoding: {}", (int)encoding));
 		}
-		const auto &codec = (*iter);
 
+		rect_lossy_.clear();
 		auto err = co_await codec->decode(*stream_, UpdateRect.r, frame_, shared_from_this());
 		if (err)
 			co_return err;
+
+		if (!codec->is_frame_codec())
+			continue;
+
+		/* ultrazip packs its own sub-rects; the header only carries counts */
+		rect damaged{UpdateRect.r.x.value(), UpdateRect.r.y.value(), UpdateRect.r.w.value(),
+			     UpdateRect.r.h.value()};
+		if (encoding == proto::rfbEncodingUltraZip)
+			damaged = rect{0, 0, frame_.width(), frame_.height()};
+		damage_.add(damaged);
+		damaged_area += damaged.area();
+
+		/* copied pixels keep whatever quality their source had */
+		if (encoding != proto::rfbEncodingCopyRect) {
+			lossy_.subtract(damaged);
+			lossy_.add(rect_lossy_);
+		}
+		/* any answer counts, whatever is still lossy gets another refresh later */
+		refine_pending_.subtract(damaged);
+
+		/* show what has arrived so far when a large update takes a while */
+		auto now = std::chrono::steady_clock::now();
+		auto partial_ms = progressive_ms_.load();
+		auto partial_limit = progressive_bytes_.load();
+		if ((partial_ms > 0 && now - partial_time >= std::chrono::milliseconds(partial_ms)) ||
+		    (partial_limit > 0 && stream_->bytes_read() - partial_bytes >= partial_limit)) {
+			commit_damage();
+			partial_time = now;
+			partial_bytes = stream_->bytes_read();
+		}
+	}
+	pipeline_.on_update_end(stream_->read_wait() - read_wait);
+	scheduler_.on_update(damaged_area, std::size_t(frame_.width()) * frame_.height());
+	if (damaged_area * 256 > std::size_t(frame_.width()) * frame_.height())
+		last_activity_ = std::chrono::steady_clock::now();
+	/* the fast first frame or the lossless refresh is in, back to the configured quality */
+	bool first_frame = first_frame_pending_.exchange(false);
+	bool refined = refining_ && refine_pending_.empty();
+	if (refined)
+		refining_ = false;
+	if (refined || first_frame)
+		send_frame_encodings(preferred_frame_encodings());
+	if (decode_budget_.on_update(pipeline_.decode_time()))
+		apply_decode_budget();
+	apply_auto_select(stream_->bytes_read() - bytes_read, stream_->read_wait() - read_wait);
+	request_updates(1);
+	commit_damage();
+
+	co_return error{};
+}
+
+void client_impl::commit_damage()
+{
+	if (!converter_.is_identity())
+		converter_.convert(frame_, output_frame_, damage_);
+
+	present_damage_.add(damage_);
+	damage_.clear();
+	schedule_present();
+}
+
+void client_impl::refine_lossy()
+{
+	if (!lossless_refresh_ || refining_ || first_frame_pending_ || lossy_.empty() ||
+	    status_ != client::status::connected)
+		return;
+
+	/* wait for the screen to settle, areas still in motion would be sent lossily again */
+	if (std::chrono::steady_clock::now() - last_activity_ < detail::refine_delay)
+		return;
+
+	refining_ = true;
+	if (!send_frame_encodings(preferred_frame_encodings())) {
+		refining_ = false;
+		return;
+	}
+	spdlog::debug("Lossless refresh of {} rects", lossy_.rects().size());
+	refine_pending_ = lossy_;
+	for (const auto &r : lossy_.rects())
+		send_update_request_msg(r, false);
+}
+
+void client_impl::schedule_present()
+{
+	if (present_on_tick_ || present_timer_armed_ || present_damage_.empty())
+		return;
+
+	auto due = last_present_ + std::chrono::milliseconds(present_interval_ms_.load());
+	if (due <= std::chrono::steady_clock::now()) {
+		present();
+		return;
+	}
+
+	present_timer_armed_ = true;
+	present_timer_.expires_at(due);
+	present_timer_.async_wait([this, self = shared_from_this()](boost::system::error_code ec) {
+		if (ec == boost::asio::error::operation_aborted)
+			return;
+		present_timer_armed_ = false;
+		if (!present_on_tick_)
+			present();
+	});
+}
+
+void client_impl::present()
+{
+	if (present_damage_.empty())
+		return;
+
+	last_present_ = std::chrono::steady_clock::now();
+	handler_.on_frame_damage(frame(), present_damage_);
+	awaited_damage_.add(present_damage_);
+	++frame_generation_;
+	frame_signal_.cancel();
+	present_damage_.clear();
+}
+
+void client_impl::set_present_on_tick(bool enabled)
+{
+	present_on_tick_ = enabled;
+	/* anything held back for a tick goes out under the interval again */
+	if (!enabled)
+		boost::asio::dispatch(strand_, [this, self = shared_from_this()]() { schedule_present(); });
+}
+
+void client_impl::present_tick()
+{
+	boost::asio::dispatch(strand_, [this, self = shared_from_this()]() { present(); });
+}
+
+boost::asio::awaitable<error> client_impl::co_next_frame(client::frame_update &update)
+{
+	while (awaited_generation_ == frame_generation_) {
+		if (status_ == client::status::closed)
+			co_return error::make_error(boost::asio::error::operation_aborted);
+
+		/* never expires on its own, present() and close() cancel it */
+		boost::system::error_code ec;
+		frame_signal_.expires_at(boost::asio::steady_timer::time_point::max());
+		co_await frame_signal_.async_wait(net_awaitable[ec]);
 	}
-	send_framebuffer_update_request(true);
-	handler_.on_frame_update(frame_);
+	update.damage = std::exchange(awaited_damage_, {});
+	update.generation = frame_generation_;
+	awaited_generation_ = frame_generation_;
+	co_return error{};
+}
 
+boost::asio::awaitable<error> client_impl::co_next_event(client::event &ev)
+{
+	if (!event_channel_) {
+		event_channel_ =
+			std::make_unique<client_delegate_proxy::event_channel>(strand_, detail::max_buffered_events);
+		handler_.set_event_channel(event_channel_.get());
+	}
+	/* events published up to the close are still handed out, then the caller is told */
+	if (status_ == client::status::closed) {
+		bool buffered = event_channel_->try_receive([&](boost::system::error_code, client::event e) {
+			ev = std::move(e);
+		});
+		co_return buffered ? error{} : error::make_error(boost::asio::error::operation_aborted);
+	}
+
+	boost::system::error_code ec;
+	ev = co_await event_channel_->async_receive(net_awaitable[ec]);
+	/* only close() cancels the channel */
+	if (ec)
+		co_return error::make_error(boost::asio::error::operation_aborted);
 	co_return error{};
 }
 
 boost::asio::awaitable<libvnc::error> client_impl::on_rfbSetColourMapEntries()
 {
+	boost::system::error_code ec;
+	proto::rfbSetColourMapEntriesMsg msg{};
+	co_await boost::asio::async_read(*stream_, boost::asio::buffer(&msg, sizeof(msg)), net_awaitable[ec]);
+	if (ec)
+		co_return error::make_error(ec);
+
+	std::vector<proto::rfbColourMapEntry> entries(msg.nColours.value());
+	co_await boost::asio::async_read(*stream_, boost::asio::buffer(entries), net_awaitable[ec]);
+	if (ec)
+		co_return error::make_error(ec);
+
+	converter_.set_colour_map(msg.firstColour.value(), entries);
+	spdlog::info("Got {} colour map entries starting at {}", entries.size(), msg.firstColour.value());
+
+	/* every pixel may refer to a changed entry */
+	if (!converter_.is_identity() && !frame_.pixel_format().trueColour.value()) {
+		damage_.add(rect{0, 0, frame_.width(), frame_.height()});
+		commit_damage();
+	}
 	co_return error{};
 }
 
@@ -1133,8 +1918,7 @@ boost::asio::awaitable<libvnc::error> client_impl::on_rfbServerCutText()
 		spdlog::info("rfbServerCutTextMsg. default cap.");
 		// client->extendedClipboardServerCapabilities |=
 		//     rfbExtendedClipboard_Text; /* for now, only text */
-		extendedClipboardServerCapabilities_.reset();
-		extendedClipboardServerCapabilities_ |= proto::rfbExtendedClipboard_Text;
+		extendedClipboardServerCapabilities_ = proto::rfbExtendedClipboard_Text;
 		co_return error{};
 	}
 
@@ -1256,4 +2040,91 @@ boost::asio::awaitable<libvnc::error> client_impl::on_rfbKeepAlive()
 	co_return error{};
 }
 
+boost::asio::awaitable<libvnc::error> client_impl::on_rfbEndOfContinuousUpdates()
+{
+	/* the first one is unsolicited and only announces support */
+	if (!cu_supported_) {
+		cu_supported_ = true;
+		supported_messages_.set_client2server(proto::rfbEnableContinuousUpdates);
+		spdlog::info("Server supports continuous updates");
+		apply_continuous_updates();
+		co_return error{};
+	}
+
+	bool requested = cu_ending_;
+	cu_active_ = false;
+	cu_ending_ = false;
+	if (requested && want_continuous_updates()) {
+		/* switched back on while waiting for the server */
+		apply_continuous_updates();
+		co_return error{};
+	}
+	request_updates(1);
+	co_return error{};
+}
+
+boost::asio::awaitable<libvnc::error> client_impl::on_rfbFence()
+{
+	boost::system::error_code ec;
+	proto::rfbFenceMsg msg{};
+	co_await boost::asio::async_read(*stream_, boost::asio::buffer(&msg, sizeof(msg)), net_awaitable[ec]);
+	if (ec)
+		co_return error::make_error(ec);
+
+	std::array<uint8_t, 64> payload{};
+	auto length = msg.length.value();
+	if (length > payload.size())
+		co_return error::make_error(custom_error::frame_error,
+					    fmt::format("Fence payload too large: {}", length));
+
+	co_await boost::asio::async_read(*stream_, boost::asio::buffer(payload.data(), length), net_awaitable[ec]);
+	if (ec)
+		co_return error::make_error(ec);
+
+	supported_messages_.set_client2server(proto::rfbFence);
+
+	auto flags = msg.flags.value();
+	if (!(flags & proto::rfbFenceFlagRequest)) {
+		if (rtt_probe_sent_ &&
+		    std::ranges::equal(std::span(payload.data(), length), detail::rtt_probe_payload)) {
+			auto_select_.on_rtt(std::chrono::steady_clock::now() - *rtt_probe_sent_);
+			rtt_probe_sent_.reset();
+		}
+		co_return error{};
+	}
+
+	/* Messages are handled in order, so everything sent before the fence has been processed
+	   (BlockBefore) and the reply is queued ahead of anything sent after it (BlockAfter).
+	   The server times these replies to keep its own send queue from building up. */
+	flags &= proto::rfbFenceFlagsSupported & ~proto::rfbFenceFlagRequest;
+	send_fence(flags, std::span<const uint8_t>(payload.data(), length));
+	co_return error{};
+}
+
+boost::asio::awaitable<libvnc::error> client_impl::on_rfbServerState()
+{
+	boost::system::error_code ec;
+	proto::rfbServerStateMsg msg{};
+	co_await boost::asio::async_read(*stream_, boost::asio::buffer(&msg, sizeof(msg)), net_awaitable[ec]);
+	if (ec)
+		co_return error::make_error(ec);
+
+	switch (msg.state.value()) {
+	case proto::rfbKeepAliveInterval:
+		spdlog::info("Server keepalive interval: {}s", msg.value.value());
+		break;
+	case proto::rfbIdleInputTimeout:
+		/* the server drops the session after this long without input; update
+		   requests don't count, so the idle backoff doesn't change it */
+		spdlog::info("Server idle input timeout: {}s", msg.value.value());
+		break;
+	case proto::rfbServerRemoteInputsState:
+		spdlog::info("Server remote inputs {}", msg.value.value() ? "disabled" : "enabled");
+		break;
+	default:
+		break;
+	}
+	co_return error{};
+}
+
 } // namespace libvnc
\ No newline at end of file
@@ -1,16 +1,28 @@
 #pragma once
+#include "auto_select.hpp"
 #include "client_delegate_proxy.hpp"
+#include "decode_budget.hpp"
 #include "encoding/encoding.h"
 #include "libvnc-cpp/client.h"
 #include "libvnc-cpp/error.h"
 #include "libvnc-cpp/proto.h"
+#include "libvnc-cpp/region.h"
+#include "mpsc_ring.hpp"
+#include "pixel/converter.h"
+#include "request_pipeline.hpp"
+#include "send_buffer.hpp"
 #include "spdlog/spdlog.h"
 #include "supported_messages.hpp"
+#include "update_scheduler.hpp"
 #include <boost/asio/awaitable.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/read.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
+#include <algorithm>
+#include <array>
 #include <map>
+#include <mutex>
 #include <queue>
 #include <set>
 #include <span>
@@ -30,6 +42,8 @@ public:
 
 	bool send_format(const proto::rfbPixelFormat &format);
 	bool send_frame_encodings(const std::vector<std::string> &encodings);
+	/** Remembers encodings as the application's choice, which automatic re-sends reorder but keep. */
+	bool send_requested_encodings(const std::vector<std::string> &encodings);
 	bool send_scale_setting(int scale);
 	bool send_ext_desktop_size(const std::vector<proto::rfbExtDesktopScreen> &screens);
 	bool send_key_event(uint32_t key, bool down);
@@ -49,10 +63,23 @@ public:
 
 	bool send_set_monitor(uint8_t nbr);
 
+	void set_continuous_updates(bool enabled);
+	void set_auto_select(bool enabled);
+	void set_decode_budget(std::chrono::steady_clock::duration budget);
+	void set_viewport(std::vector<rect> rects);
+	void set_idle_backoff(std::chrono::steady_clock::duration max_interval);
+	void set_max_fps(int fps);
+	void set_present_on_tick(bool enabled);
+	void present_tick();
+	boost::asio::awaitable<error> co_next_frame(client::frame_update &update);
+	boost::asio::awaitable<error> co_next_event(client::event &ev);
+	bool send_fence(uint32_t flags, std::span<const uint8_t> payload);
+
 	void send_framebuffer_update_request(int x, int y, int w, int h, bool incremental);
 	void send_framebuffer_update_request(bool incremental) override;
 
 	std::vector<std::string> supported_frame_encodings() const;
+	std::vector<std::string> preferred_frame_encodings() const;
 
 private:
 	boost::asio::awaitable<error> co_run();
@@ -70,18 +97,44 @@ private:
 
 	bool send_msg_to_server(const proto::rfbClientToServerMsg &ID, const void *data, std::size_t len);
 	bool send_msg_to_server_buffers(const proto::rfbClientToServerMsg &ID,
-					const std::vector<boost::asio::const_buffer> &buffers);
+					std::span<const boost::asio::const_buffer> buffers);
 
 	template<typename... Buffers>
 	bool send_msg_to_server_buffers(const proto::rfbClientToServerMsg &ID, const Buffers &...buffers)
 	{
-		std::vector<boost::asio::const_buffer> bufs;
-		(bufs.push_back(boost::asio::buffer(buffers)), ...);
-		return send_msg_to_server_buffers(ID, bufs);
+		std::array<boost::asio::const_buffer, sizeof...(Buffers)> bufs{boost::asio::buffer(buffers)...};
+		return send_msg_to_server_buffers(ID, std::span<const boost::asio::const_buffer>(bufs));
 	}
-	void send_raw_data(std::vector<uint8_t> &&data);
+	void flush_send_buffer();
+	void attach_writer();
+	void detach_writer();
+	bool send_input_msg(const proto::rfbClientToServerMsg &ID, const void *data, std::size_t len);
+	void drain_input();
+	bool move_input_to_send_buffer();
 	void commit_status(const client::status &s);
 
+	proto::rfbPixelFormat negotiate_wire_format(const proto::rfbPixelFormat &server_format,
+						    const proto::rfbPixelFormat &output_format);
+	void commit_damage();
+	void schedule_present();
+	void refine_lossy();
+	void present();
+	void apply_continuous_updates();
+	bool want_continuous_updates() const;
+	void request_updates(int depth);
+	std::chrono::steady_clock::duration request_interval() const;
+	void note_input();
+	bool send_update_request_msg(const rect &r, bool incremental);
+	void send_viewport_request(bool incremental);
+	std::vector<rect> viewport_rects() const;
+	bool background_refresh_due();
+	void apply_viewport(std::vector<rect> rects, std::optional<uint32_t> screen_id);
+	void select_viewport_screen(std::optional<uint32_t> screen_id);
+	bool send_enable_continuous_updates(bool enable);
+	void apply_auto_select(std::uint64_t bytes, std::chrono::steady_clock::duration wait);
+	void send_rtt_probe();
+	void apply_decode_budget();
+
 	proto::rfbAuthScheme select_auth_scheme(const std::set<proto::rfbAuthScheme> &auths);
 
 protected:
@@ -93,6 +146,7 @@ protected:
 	void handle_supported_messages(const proto::rfbSupportedMessages &messages) override;
 	void handle_ext_desktop_screen(const std::vector<proto::rfbExtDesktopScreen> &screens) override;
 	void handle_resize_client_buffer(int width, int height);
+	void handle_lossy_rect(int x, int y, int w, int h) override;
 
 private:
 	boost::asio::awaitable<error> on_rfbNoAuth();
@@ -112,28 +166,58 @@ private:
 	boost::asio::awaitable<error> on_rfbPalmVNCReSizeFrameBuffer();
 	boost::asio::awaitable<error> on_rfbMonitorInfo();
 	boost::asio::awaitable<error> on_rfbKeepAlive();
+	boost::asio::awaitable<error> on_rfbEndOfContinuousUpdates();
+	boost::asio::awaitable<error> on_rfbFence();
+	boost::asio::awaitable<error> on_rfbServerState();
 
 private:
 	template<typename T, typename... _Types>
 	requires std::derived_from<T, encoding::codec> void register_encoding(_Types &&..._Args)
 	{
 		auto codec = std::make_unique<T>(std::forward<_Types>(_Args)...);
+		auto code = codec->encoding_code();
+		auto pos = std::ranges::lower_bound(codec_index_, code, {}, &codec_entry::first);
+		codec_index_.emplace(pos, code, codec.get());
 		codecs_.push_back(std::move(codec));
 	}
-	template<class _Fx, class... _Types> void register_message(uint8_t ID, _Fx &&_Func, _Types &&..._Args)
-	{
-		message_map_.emplace(ID, std::bind(std::forward<_Fx>(_Func), std::forward<_Types>(_Args)...));
-	}
-	template<class _Fx, class... _Types> void register_auth_message(uint8_t ID, _Fx &&_Func, _Types &&..._Args)
-	{
-		auth_message_map_.emplace(ID, std::bind(std::forward<_Fx>(_Func), std::forward<_Types>(_Args)...));
-	}
+	encoding::codec *find_codec(proto::rfbEncoding encoding);
+
+	using message_handler = boost::asio::awaitable<error> (client_impl::*)();
+	void register_message(uint8_t ID, message_handler handler) { message_map_[ID] = handler; }
+	void register_auth_message(uint8_t ID, message_handler handler) { auth_message_map_.emplace(ID, handler); }
 
 public:
 	boost::asio::strand<boost::asio::any_io_executor> strand_;
 	boost::asio::ip::tcp::resolver resolver_;
 	vnc_stream_ptr stream_;
-	std::deque<std::vector<uint8_t>> send_que_;
+	send_buffer send_buffer_;
+
+	/** Runs the send path: flushing send_buffer_ and draining input_ring_, on its own
+	    reference to the connection's stream. Plain TCP writes are started here, so input
+	    and requests go out while strand_ is busy decoding. A TLS stream shares its SSL
+	    state between both directions, so its writes are started and completed on strand_. */
+	boost::asio::strand<boost::asio::any_io_executor> write_strand_;
+	/* write_strand_ only, handed over by attach_writer() and dropped by detach_writer() */
+	vnc_stream_ptr write_stream_;
+	bool write_tls_ = false;
+	/* strand_ only */
+	bool writer_attached_ = false;
+
+	/** key and pointer events already encoded for the wire, queued lock-free by the calling
+	    thread and moved into send_buffer_ on the writer strand. One drain is scheduled per batch. */
+	struct input_record {
+		proto::rfbClientToServerMsg id;
+		uint8_t length;
+		std::array<uint8_t, 14> data;
+	};
+	mpsc_ring<input_record, 1024> input_ring_;
+	/* the ring's consumer side: the drain, or a sender that could not use the ring */
+	std::mutex input_drain_mutex_;
+	std::atomic_bool input_drain_scheduled_ = false;
+	/* set from any thread by client::send_frame_encodings(), empty means every supported one */
+	mutable std::mutex requested_encodings_mutex_;
+	std::vector<std::string> requested_encodings_;
+	std::atomic_bool coalesce_pointer_ = true;
 
 	std::string host_ = "127.0.0.1";
 	uint16_t port_ = 5900;
@@ -142,8 +226,16 @@ public:
 	std::atomic_int compress_level_ = 3;
 	std::atomic_int quality_level_ = 9;
 	std::string notifiction_text_;
+	std::atomic<client::wire_format> wire_format_ = client::wire_format::requested;
+	std::atomic_bool continuous_updates_ = true;
 
+	/** frame_ holds the wire format the codecs decode into; output_frame_ holds want_format()
+	    and is only used when the two differ. */
 	frame_buffer frame_;
+	frame_buffer output_frame_;
+	frame_buffer cursor_frame_;
+	pixel::converter converter_;
+	region damage_;
 
 	std::vector<proto::rfbExtDesktopScreen> screens_;
 
@@ -154,17 +246,85 @@ public:
 	supported_messages supported_messages_;
 
 	std::vector<std::unique_ptr<encoding::codec>> codecs_;
-	using message_handler = std::function<boost::asio::awaitable<error>()>;
-	std::map<uint8_t, message_handler> message_map_;
+	/** codecs_ sorted by encoding for the per-rect lookup; the last hit is checked first,
+	    since updates tend to use one encoding for all of their rects */
+	using codec_entry = std::pair<proto::rfbEncoding, encoding::codec *>;
+	std::vector<codec_entry> codec_index_;
+	codec_entry last_codec_{};
+	/** indexed by message type, empty slots are unknown messages */
+	std::array<message_handler, 256> message_map_{};
 	std::map<uint8_t, message_handler> auth_message_map_;
 
 	std::atomic<client::status> status_ = client::status::closed;
 	std::string desktop_name_;
 	std::atomic_int current_keyboard_led_state_ = 0;
-	std::bitset<32> extendedClipboardServerCapabilities_;
+	std::atomic_uint32_t extendedClipboardServerCapabilities_ = 0;
 	std::atomic_uint nbrMonitors_ = 0;
 	std::atomic_bool ultra_server_ = false;
 	std::atomic_bool brfbClientInitExtraMsgSupportNew_ = false;
+
+	/** continuous updates state, only touched on the strand. cu_ending_ is set between
+	    disabling and the server's EndOfContinuousUpdates, when no requests may be sent. */
+	bool cu_supported_ = false;
+	bool cu_active_ = false;
+	bool cu_ending_ = false;
+
+	request_pipeline pipeline_;
+
+	/** link measurements driving the encoding choice, only touched on the strand.
+	    rtt_probe_sent_ is set while a fence probe is waiting for its reply. */
+	std::atomic_bool auto_select_enabled_ = false;
+	auto_select auto_select_;
+	std::optional<std::chrono::steady_clock::time_point> rtt_probe_sent_;
+
+	/** local CPU feedback; when it limits the update rate, requests closer together than
+	    min_request_interval() wait on request_timer_ instead of going out at once. */
+	decode_budget decode_budget_;
+	update_scheduler scheduler_;
+	boost::asio::steady_timer request_timer_;
+	bool request_timer_armed_ = false;
+	std::chrono::steady_clock::time_point last_request_{};
+
+	/** visible part of the frame, only touched on the strand. Empty means all of it.
+	    viewport_screen_ remembers an ExtDesktopSize screen the viewport follows. */
+	std::vector<rect> viewport_;
+	std::optional<uint32_t> viewport_screen_;
+	std::atomic_int background_refresh_ms_ = 2000;
+	std::chrono::steady_clock::time_point last_background_refresh_{};
+
+	/** damage converted but not yet handed to the delegate. Frame callbacks are spaced at
+	    least present_interval_ms_ apart, or wait for present_tick() when present_on_tick_. */
+	region present_damage_;
+	boost::asio::steady_timer present_timer_;
+	bool present_timer_armed_ = false;
+	std::chrono::steady_clock::time_point last_present_{};
+	std::atomic_int present_interval_ms_ = 0;
+	std::atomic_bool present_on_tick_ = false;
+
+	/** async_next_frame(): present() bumps the generation and cancels the signal to wake the
+	    waiter, which takes everything presented since it last looked */
+	boost::asio::steady_timer frame_signal_;
+	region awaited_damage_;
+	std::uint64_t frame_generation_ = 0;
+	std::uint64_t awaited_generation_ = 0;
+	/** created by the first async_next_event(), the proxy publishes to it from then on */
+	std::unique_ptr<client_delegate_proxy::event_channel> event_channel_;
+
+	/** partial commits within one FramebufferUpdate, zero disables either budget */
+	std::atomic_int progressive_ms_ = 0;
+	std::atomic<std::uint64_t> progressive_bytes_ = 0;
+
+	/** lossy areas awaiting a lossless refresh, only touched on the strand. While refining_
+	    the quality level is left out of SetEncodings, which stops Tight servers using JPEG;
+	    it stays out until updates have covered all of refine_pending_. */
+	std::atomic_bool fast_first_frame_ = false;
+	std::atomic_bool lossless_refresh_ = false;
+	std::atomic_bool first_frame_pending_ = false;
+	std::atomic_bool refining_ = false;
+	region rect_lossy_;
+	region lossy_;
+	region refine_pending_;
+	std::chrono::steady_clock::time_point last_activity_{};
 };
 
 } // namespace libvnc
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "decode_budget.hpp"
+#include <algorithm>
+
+namespace libvnc {
+
+namespace detail {
+
+struct degrade_step {
+	int quality_cap;
+	int min_interval_ms;
+	std::string_view encoding;
+};
+
+static constexpr degrade_step degrade_steps[] = {
+	{9, 0, {}},
+	{6, 0, {}},
+	{3, 0, {}},
+	{3, 0, "hextile"},
+	{3, 50, "hextile"},
+	{1, 100, "hextile"},
+};
+
+} // namespace detail
+
+void decode_budget::set_budget(clock::duration budget)
+{
+	budget_ = std::max<clock::rep>(budget.count(), 0);
+}
+
+decode_budget::clock::duration decode_budget::budget() const
+{
+	return clock::duration(budget_.load());
+}
+
+void decode_budget::reset()
+{
+	step_ = 0;
+	over_ = 0;
+	under_ = 0;
+}
+
+bool decode_budget::on_update(clock::duration decode_time)
+{
+	auto budget = this->budget();
+	if (budget == clock::duration::zero()) {
+		bool changed = step_ != 0;
+		reset();
+		return changed;
+	}
+
+	if (decode_time > budget) {
+		under_ = 0;
+		if (++over_ < over_count || step_ == max_step)
+			return false;
+		over_ = 0;
+		++step_;
+		return true;
+	}
+
+	over_ = 0;
+	/* only recover with clear headroom, otherwise the steps would oscillate */
+	if (step_ == 0 || decode_time * 2 > budget || ++under_ < under_count)
+		return false;
+	under_ = 0;
+	--step_;
+	return true;
+}
+
+int decode_budget::step() const
+{
+	return step_;
+}
+
+int decode_budget::quality_cap() const
+{
+	return detail::degrade_steps[step_].quality_cap;
+}
+
+decode_budget::clock::duration decode_budget::min_request_interval() const
+{
+	return std::chrono::milliseconds(detail::degrade_steps[step_].min_interval_ms);
+}
+
+std::string_view decode_budget::preferred_encoding() const
+{
+	return detail::degrade_steps[step_].encoding;
+}
+
+} // namespace libvnc
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <string_view>
+
+namespace libvnc {
+
+/** Backs off when updates take longer to decode than the configured budget.
+    Each step trades picture quality, bandwidth or update rate for CPU time: first
+    lower JPEG quality (Tight servers also raise chroma subsampling with it), then
+    prefer Hextile, which needs neither zlib nor JPEG, then fewer updates per second.
+    Steps are taken after a few updates over budget and undone one at a time once
+    decoding has stayed well inside it. */
+class decode_budget {
+public:
+	using clock = std::chrono::steady_clock;
+
+	/** zero (default) turns the feedback loop off */
+	void set_budget(clock::duration budget);
+	clock::duration budget() const;
+	void reset();
+
+	/** Feeds the smoothed decode time of the last update. Returns true when the step changed. */
+	bool on_update(clock::duration decode_time);
+
+	int step() const;
+	/** highest quality level the current step allows, 9 when not degraded */
+	int quality_cap() const;
+	/** shortest time between update requests the current step allows */
+	clock::duration min_request_interval() const;
+	/** encoding the current step asks to put first, empty when not degraded that far */
+	std::string_view preferred_encoding() const;
+
+private:
+	constexpr static int max_step = 5;
+	constexpr static int over_count = 8;
+	constexpr static int under_count = 32;
+
+	std::atomic<clock::rep> budget_ = 0;
+	std::atomic_int step_ = 0;
+	int over_ = 0;
+	int under_ = 0;
+};
+
+} // namespace libvnc
@@ -0,0 +1,173 @@
+#include "delegate_dispatcher.hpp"
+#include "pixel/converter.h"
+#include <boost/asio/post.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+namespace libvnc {
+
+namespace detail {
+
+static bool same_shape(const frame_buffer &a, const frame_buffer &b)
+{
+	return a.width() == b.width() && a.height() == b.height() &&
+	       pixel::converter::same_format(a.pixel_format(), b.pixel_format());
+}
+
+/* copies the damaged rects of src into dst, reallocating dst when src changed shape */
+static void copy_damage(const frame_buffer &src, frame_buffer &dst, const region &damage)
+{
+	if (!same_shape(src, dst)) {
+		dst.init(src.width(), src.height(), src.pixel_format());
+		std::memcpy(dst.data(), src.data(), std::min(src.size(), dst.size()));
+		return;
+	}
+	for (const auto &r : damage.rects()) {
+		if (!src.check_rect(r.x, r.y, r.w, r.h))
+			continue;
+		std::size_t row_bytes = (std::size_t)r.w * src.bytes_per_pixel();
+		for (int y = r.y; y < r.y + r.h; ++y)
+			std::memcpy(dst.data(r.x, y), src.data(r.x, y), row_bytes);
+	}
+}
+
+} // namespace detail
+
+delegate_dispatcher::delegate_dispatcher(const boost::asio::any_io_executor &executor)
+	: strand_(executor)
+{
+}
+
+void delegate_dispatcher::set_handler(client_delegate *handler)
+{
+	handler_.store(handler);
+}
+
+void delegate_dispatcher::wait_idle() const
+{
+	if (current_ == this)
+		return;
+	while (active_.load() != 0)
+		std::this_thread::yield();
+}
+
+void delegate_dispatcher::post(event ev, retention retain, std::uint32_t tag)
+{
+	auto type = kind::event;
+	if (retain == retention::keep)
+		type = kind::kept;
+	else if (retain == retention::latest)
+		type = kind::latest;
+
+	std::lock_guard lck(mutex_);
+	push(entry{type, std::move(ev), {}, tag});
+}
+
+void delegate_dispatcher::post_cursor_pos(int x, int y)
+{
+	std::lock_guard lck(mutex_);
+	push(entry{kind::cursor_pos, [x, y](client_delegate &handler) { handler.on_cursor_pos(x, y); }, {}});
+}
+
+void delegate_dispatcher::post_cursor_shape(int xhot, int yhot, const frame_buffer &rc_source, const uint8_t *rc_mask)
+{
+	/* the codec reuses both buffers for the next shape */
+	auto source = std::make_shared<frame_buffer>();
+	detail::copy_damage(rc_source, *source, {});
+	std::vector<uint8_t> mask(rc_mask, rc_mask + (std::size_t)rc_source.width() * rc_source.height());
+
+	post([xhot, yhot, source = std::move(source), mask = std::move(mask)](client_delegate &handler) {
+		handler.on_cursor_shape(xhot, yhot, *source, mask.data());
+	});
+}
+
+void delegate_dispatcher::post_frame(const frame_buffer &frame, const region &damage)
+{
+	std::lock_guard lck(mutex_);
+	region changed = damage;
+	if (!detail::same_shape(frame, staging_))
+		changed.add(rect{0, 0, frame.width(), frame.height()});
+	detail::copy_damage(frame, staging_, changed);
+	push(entry{kind::frame, {}, std::move(changed)});
+}
+
+std::uint64_t delegate_dispatcher::dropped() const
+{
+	return dropped_.load(std::memory_order_relaxed);
+}
+
+void delegate_dispatcher::push(entry e)
+{
+	/* frames and cursor moves merge into a directly preceding entry of the same kind,
+	   latest-only events only once the application has fallen behind */
+	bool full = queue_.size() >= max_events;
+	bool merges = e.type == kind::frame || e.type == kind::cursor_pos || (e.type == kind::latest && full);
+	if (merges && !queue_.empty() && queue_.back().type == e.type && queue_.back().tag == e.tag) {
+		auto &last = queue_.back();
+		if (e.type == kind::frame)
+			last.damage.add(e.damage);
+		else
+			last.ev = std::move(e.ev);
+		return;
+	}
+	/* merged kinds never follow each other, so they add at most one entry per event */
+	if (e.type == kind::event && full) {
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		if (!std::exchange(dropping_, true))
+			spdlog::warn("Delegate executor is {} events behind, dropping events", queue_.size());
+		return;
+	}
+	queue_.push_back(std::move(e));
+
+	if (!std::exchange(scheduled_, true))
+		boost::asio::post(strand_, [self = shared_from_this()]() { self->deliver(); });
+}
+
+void delegate_dispatcher::deliver()
+{
+	{
+		std::lock_guard lck(mutex_);
+		batch_.clear();
+		batch_.swap(queue_);
+		scheduled_ = false;
+		dropping_ = false;
+		for (const auto &e : batch_) {
+			if (e.type == kind::frame)
+				detail::copy_damage(staging_, delivered_, e.damage);
+		}
+	}
+
+	/* same protocol as client_delegate_proxy: only this strand writes active_ */
+	struct call_guard {
+		delegate_dispatcher &self;
+		const delegate_dispatcher *outer;
+		explicit call_guard(delegate_dispatcher &d)
+			: self(d)
+			, outer(std::exchange(current_, &d))
+		{
+			self.active_.store(self.active_.load(std::memory_order_relaxed) + 1);
+		}
+		~call_guard()
+		{
+			self.active_.store(self.active_.load(std::memory_order_relaxed) - 1, std::memory_order_release);
+			current_ = outer;
+		}
+	};
+
+	call_guard guard(*this);
+	auto handler = handler_.load();
+	for (auto &e : batch_) {
+		if (!handler)
+			break;
+		if (e.type == kind::frame)
+			handler->on_frame_damage(delivered_, e.damage);
+		else
+			e.ev(*handler);
+	}
+	batch_.clear();
+}
+
+} // namespace libvnc
@@ -0,0 +1,80 @@
+#pragma once
+#include "libvnc-cpp/client.h"
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/strand.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace libvnc {
+
+/** Carries delegate callbacks over to an application executor, so the network strand
+    never runs user code. Events keep their order in a bounded queue; consecutive frame
+    notifications merge into one with their damage combined, and cursor moves replace
+    each other. Frames are delivered from a snapshot: the strand copies damaged rects
+    into a staging buffer, the delivering side copies them on into the frame it hands
+    out, and neither copy waits on a callback. An application that falls far behind
+    loses minor events, counted by dropped(), but never connect, disconnect or the
+    latest status, frame size, clipboard or bell. */
+class delegate_dispatcher : public std::enable_shared_from_this<delegate_dispatcher> {
+public:
+	using event = std::function<void(client_delegate &)>;
+
+	/** what may happen to an event once max_events are queued */
+	enum class retention {
+		droppable,
+		keep,
+		/* merges into a directly preceding event with the same tag */
+		latest,
+	};
+
+	explicit delegate_dispatcher(const boost::asio::any_io_executor &executor);
+
+	void set_handler(client_delegate *handler);
+	/** Returns once no callback with a previous handler is running, unless called from one. */
+	void wait_idle() const;
+
+	void post(event ev, retention retain = retention::droppable, std::uint32_t tag = 0);
+	void post_cursor_pos(int x, int y);
+	void post_cursor_shape(int xhot, int yhot, const frame_buffer &rc_source, const uint8_t *rc_mask);
+	void post_frame(const frame_buffer &frame, const region &damage);
+
+	std::uint64_t dropped() const;
+
+private:
+	/* droppable events beyond this are dropped, rather than letting a stuck application grow the queue */
+	constexpr static std::size_t max_events = 1024;
+
+	enum class kind { event, kept, latest, cursor_pos, frame };
+	struct entry {
+		kind type;
+		event ev;
+		region damage;
+		std::uint32_t tag = 0;
+	};
+
+	void push(entry e);
+	void deliver();
+
+	boost::asio::strand<boost::asio::any_io_executor> strand_;
+	std::atomic<client_delegate *> handler_ = nullptr;
+	std::atomic<uint32_t> active_ = 0;
+
+	std::mutex mutex_;
+	std::vector<entry> queue_;
+	bool scheduled_ = false;
+	bool dropping_ = false;
+	frame_buffer staging_;
+	std::atomic<std::uint64_t> dropped_ = 0;
+
+	/* only touched on strand_ */
+	frame_buffer delivered_;
+	std::vector<entry> batch_;
+
+	static inline thread_local const delegate_dispatcher *current_ = nullptr;
+};
+
+} // namespace libvnc
@@ -4,6 +4,10 @@
 #include "libvnc-cpp/proto.h"
 #include <boost/asio/awaitable.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <chrono>
 #include <spdlog/spdlog.h>
 #include "stream/stream.hpp"
 
@@ -21,6 +25,29 @@ public:
 	virtual void handle_supported_messages(const proto::rfbSupportedMessages &messages) = 0;
 	virtual void handle_ext_desktop_screen(const std::vector<proto::rfbExtDesktopScreen> &screens) = 0;
 	virtual void handle_resize_client_buffer(int w, int h) = 0;
+	/* the rect just decoded only approximates the server's pixels (e.g. JPEG) */
+	virtual void handle_lossy_rect(int x, int y, int w, int h) = 0;
+};
+
+/** Hands the strand back to queued work once a decode has run for a slice.
+    Decoding a large zlib rect is pure CPU after its one read, so without this
+    timers and input drains on the strand would wait for the whole rect. */
+class decode_yield {
+public:
+	using clock = std::chrono::steady_clock;
+
+	bool due() const { return clock::now() >= deadline_; }
+
+	boost::asio::awaitable<void> operator()()
+	{
+		co_await boost::asio::post(co_await boost::asio::this_coro::executor, boost::asio::use_awaitable);
+		deadline_ = clock::now() + slice;
+	}
+
+private:
+	constexpr static auto slice = std::chrono::milliseconds(4);
+
+	clock::time_point deadline_ = clock::now() + slice;
 };
 
 class codec {
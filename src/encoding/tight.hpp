@@ -6,6 +6,7 @@
 #include <turbojpeg.h>
 #include <zstr.hpp>
 #include "helper.hpp"
+#include "pixel/pixel_view.hpp"
 
 namespace libvnc::encoding {
 
@@ -194,7 +195,8 @@ public:
 		int rw = rect.w.value();
 		int rh = rect.h.value();
 
-		auto bytes_per_pixel = frame.bytes_per_pixel();
+		if (!frame.check_rect(rx, ry, rw, rh))
+			co_return error::make_error(custom_error::frame_error, "Tight palette rect out of bounds");
 
 		index_reader *reader = &bytes_reader_;
 		if (rectColors_ == 2)
@@ -202,14 +204,15 @@ public:
 
 		reader->set({(const uint8_t *)decompress_data.data(), decompress_data.size()});
 
-		for (int y = 0; y < rh; y++) {
-			for (int x = 0; x < rw; x++) {
-				uint8_t *dst = frame.data(rx + x, ry + y);
-				auto index = *reader->next();
-				auto value = index_palette(index, bytes_per_pixel);
-				std::memcpy(dst, value, bytes_per_pixel);
+		pixel::dispatch_bpp(frame.bytes_per_pixel(), [&]<typename T>(std::type_identity<T>) {
+			pixel::pixel_view<T> view(frame, rx, ry, rw, rh);
+			for (int y = 0; y < rh; y++) {
+				for (int x = 0; x < rw; x++) {
+					auto index = *reader->next();
+					view.set(x, y, pixel::load_pixel<T>(index_palette(index, sizeof(T))));
+				}
 			}
-		}
+		});
 		co_return error{};
 	}
 	const uint8_t *index_palette(int index, int bytes_per_pixel) const
@@ -310,7 +313,7 @@ public:
 		if (comp_ctl == rfbTightFill)
 			co_return co_await tight_fill(socket, rect, buffer);
 		else if (comp_ctl == rfbTightJpeg)
-			co_return co_await tight_jpeg(socket, rect, buffer);
+			co_return co_await tight_jpeg(socket, rect, buffer, op);
 		else if (comp_ctl > rfbTightMaxSubencoding) {
 			co_return error::make_error(custom_error::frame_error,
 						    "Tight encoding: bad subencoding value received.");
@@ -391,6 +394,7 @@ public:
 		/* Now let's initialize compression stream if needed. */
 		int stream_id = comp_ctl & 0x03;
 
+		decode_yield yield;
 		decompress_buffer_.resize(allBytes);
 		z_streams_[stream_id]->read((char *)decompress_buffer_.data(), allBytes);
 
@@ -398,6 +402,10 @@ public:
 			co_return error::make_error(custom_error::frame_error, "Tight zlib error.");
 		}
 
+		/* inflating a large rect can take a while; let queued work run before filtering it */
+		if (yield.due())
+			co_await yield();
+
 		if (auto err = co_await _filter->proc_filter(boost::asio::buffer(decompress_buffer_), rect, buffer);
 		    err)
 			co_return err;
@@ -437,7 +445,7 @@ private:
 		co_return error{};
 	}
 	boost::asio::awaitable<error> tight_jpeg(vnc_stream_type &socket, const proto::rfbRectangle &rect,
-						 frame_buffer &frame)
+						 frame_buffer &frame, std::shared_ptr<frame_op> op)
 	{
 		auto format = frame.pixel_format();
 		auto bytes_pixel = frame.bytes_per_pixel();
@@ -500,6 +508,7 @@ private:
 			frame.got_bitmap(decompress_buffer_.data(), rx, ry, rw, rh);
 		}
 		buffer_.consume(compressedLen);
+		op->handle_lossy_rect(rx, ry, rw, rh);
 		co_return error{};
 	}
 
@@ -5,6 +5,7 @@
 #include <boost/asio/streambuf.hpp>
 #include <zstr.hpp>
 #include "helper.hpp"
+#include "pixel/pixel_view.hpp"
 
 namespace libvnc::encoding {
 
@@ -163,7 +164,12 @@ public:
 		if (ec)
 			co_return error::make_error(ec);
 
+		decode_yield yield;
 		for (int j = 0; j < rh; j += rfbZRLETileHeight) {
+			/* the zlib stream and read_buffer_ are ours alone, so a row of tiles is a safe
+			   place to pause */
+			if (yield.due())
+				co_await yield();
 			for (int i = 0; i < rw; i += rfbZRLETileWidth) {
 				int subWidth = (i + rfbZRLETileWidth > rw) ? rw - i : rfbZRLETileWidth;
 				int subHeight = (j + rfbZRLETileHeight > rh) ? rh - j : rfbZRLETileHeight;
@@ -190,8 +196,11 @@ public:
 	void handle_zrle_tile(frame_buffer &frame, std::istream &is, bool isLowCPixel, bool isHighCPixel, int rx,
 			      int ry, int rw, int rh) noexcept
 	{
-		auto format = frame.pixel_format();
-		auto bbp = format.bitsPerPixel.value();
+		/* tiles outside the frame are still decoded to keep the zlib stream in sync */
+		T scratch[rfbZRLETileWidth * rfbZRLETileHeight];
+		pixel::pixel_view<T> tile = frame.check_rect(rx, ry, rw, rh)
+						    ? pixel::pixel_view<T>(frame, rx, ry, rw, rh)
+						    : pixel::pixel_view<T>((uint8_t *)scratch, rw * sizeof(T), rw, rh);
 
 		int mode = detail::read_u8(is);
 		bool rle = mode & 128;
@@ -207,8 +216,7 @@ public:
 				palette[i] = detail::readPixel<T>(is);
 		}
 		if (palSize == 1) {
-			T pix = palette[0];
-			frame.fill_rect(rx, ry, rw, rh, (uint8_t *)&pix);
+			tile.fill(palette[0]);
 			return;
 		}
 		if (!rle) {
@@ -216,19 +224,16 @@ public:
 				if (isLowCPixel || isHighCPixel) {
 					for (int y = 0; y < rh; ++y) {
 						for (int x = 0; x < rw; ++x) {
-							auto ptr = frame.data(rx + x, ry + y);
 							if (isLowCPixel)
-								*((T *)ptr) = detail::readOpaque24A(is);
+								tile.set(x, y, detail::readOpaque24A(is));
 							else
-								*((T *)ptr) = detail::readOpaque24B(is);
+								tile.set(x, y, detail::readOpaque24B(is));
 						}
 					}
 				} else {
 					auto row_bytes = rw * sizeof(T);
-					for (int y = 0; y < rh; ++y) {
-						auto ptr = frame.data(rx, ry + y);
-						is.read((char *)ptr, row_bytes);
-					}
+					for (int y = 0; y < rh; ++y)
+						is.read((char *)tile.row(y), row_bytes);
 				}
 			} else {
 				// packed pixels
@@ -240,7 +245,7 @@ public:
 
 					for (int x = 0; x < rw; ++x) {
 						int index = reader.read(bppp);
-						frame.got_bitmap((uint8_t *)&palette[index], rx + x, ry + y, 1, 1);
+						tile.set(x, y, palette[index]);
 					}
 				}
 			}
@@ -264,15 +269,7 @@ public:
 						length += b;
 					} while (b == 255);
 
-					while (j < rh && length > 0) {
-						frame.got_bitmap((uint8_t *)&pix, rx + i, ry + j, 1, 1);
-						length--;
-						i++;
-						if (i >= rw) {
-							i = 0;
-							j++;
-						}
-					}
+					tile.run(i, j, length, pix);
 				}
 			} else {
 				// palette RLE
@@ -291,15 +288,7 @@ public:
 					}
 					index &= 0x7F;
 
-					while (j < rh && length > 0) {
-						frame.got_bitmap((uint8_t *)&palette[index], rx + i, ry + j, 1, 1);
-						length--;
-						i++;
-						if (i >= rw) {
-							i = 0;
-							j++;
-						}
-					}
+					tile.run(i, j, length, palette[index]);
 				}
 			}
 		}
@@ -1,4 +1,5 @@
 #include "libvnc-cpp/frame_buffer.h"
+#include "pixel/pixel_view.hpp"
 #include <spdlog/spdlog.h>
 
 namespace libvnc {
@@ -8,6 +9,7 @@ void frame_buffer::init(int w, int h, const proto::rfbPixelFormat &format)
 	width_ = w;
 	height_ = h;
 	format_ = format;
+	bytes_per_pixel_ = format.bitsPerPixel.value() / 8;
 	malloc_frame_buffer();
 }
 
@@ -27,6 +29,7 @@ void frame_buffer::set_format(const proto::rfbPixelFormat &format)
 	bool changed = format_.bitsPerPixel.value() != format.bitsPerPixel.value();
 
 	format_ = format;
+	bytes_per_pixel_ = format.bitsPerPixel.value() / 8;
 	if (changed)
 		malloc_frame_buffer();
 }
@@ -63,7 +66,7 @@ const uint8_t *frame_buffer::data(int x, int y) const
 
 uint8_t *frame_buffer::data(int x, int y)
 {
-	size_t offset = std::size_t(y * width_ + x) * bytes_per_pixel();
+	size_t offset = (std::size_t(y) * width_ + x) * bytes_per_pixel_;
 	return data_.data() + offset;
 }
 
@@ -74,7 +77,7 @@ std::size_t frame_buffer::size() const
 
 uint8_t frame_buffer::bytes_per_pixel() const
 {
-	return format_.bitsPerPixel.value() / 8;
+	return bytes_per_pixel_;
 }
 
 std::size_t frame_buffer::bytes_per_line() const
@@ -131,26 +134,11 @@ void frame_buffer::fill_rect(int x, int y, int w, int h, const uint8_t *colour)
 		spdlog::warn("Rect out of bounds: {}x{} at ({}, {})", x, y, w, h);
 		return;
 	}
-	auto bpp = bytes_per_pixel();
-
-	for (int i = 0; i < h; ++i) {
-		auto ptr = data(x, y + i);
-		switch (bpp) {
-		case 1: {
-			std::fill(ptr, ptr + w, *colour);
-		} break;
-		case 2: {
-			auto u16ptr = reinterpret_cast<uint16_t *>(ptr);
-			std::fill(u16ptr, u16ptr + w, *reinterpret_cast<const uint16_t *>(colour));
-		} break;
-		case 4: {
-			auto u32ptr = reinterpret_cast<uint32_t *>(ptr);
-			std::fill(u32ptr, u32ptr + w, *reinterpret_cast<const uint32_t *>(colour));
-		} break;
-		default:
-			spdlog::warn("Unsupported bitsPerPixel: {}", format_.bitsPerPixel.value());
-		}
-	}
+	bool handled = pixel::dispatch_bpp(bytes_per_pixel_, [&]<typename T>(std::type_identity<T>) {
+		pixel::pixel_view<T>(*this, x, y, w, h).fill(pixel::load_pixel<T>(colour));
+	});
+	if (!handled)
+		spdlog::warn("Unsupported bitsPerPixel: {}", format_.bitsPerPixel.value());
 }
 
 void frame_buffer::malloc_frame_buffer()
@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+
+namespace libvnc {
+
+/** Bounded lock-free queue for many producers and one consumer.
+    Each cell carries a sequence number telling whose turn it is: producers
+    claim a slot by advancing tail_, write it and publish it by bumping the
+    sequence; the consumer only ever waits on the cell at head_. */
+template<typename T, std::size_t Capacity> class mpsc_ring {
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+	static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+	mpsc_ring()
+	{
+		for (std::size_t i = 0; i < Capacity; ++i)
+			cells_[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	/** Returns false when the ring is full. */
+	bool push(const T &value)
+	{
+		auto pos = tail_.load(std::memory_order_relaxed);
+		for (;;) {
+			auto &cell = cells_[pos & (Capacity - 1)];
+			auto seq = cell.sequence.load(std::memory_order_acquire);
+			auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+			if (diff == 0) {
+				if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.value = value;
+					cell.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = tail_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/** Consumer side only. Empty when nothing has been published at the head yet. */
+	std::optional<T> pop()
+	{
+		auto &cell = cells_[head_ & (Capacity - 1)];
+		if (cell.sequence.load(std::memory_order_acquire) != head_ + 1)
+			return std::nullopt;
+
+		T value = cell.value;
+		cell.sequence.store(head_ + Capacity, std::memory_order_release);
+		++head_;
+		return value;
+	}
+
+private:
+	/* keep producers and the consumer off each other's cache lines */
+	constexpr static std::size_t cache_line = 64;
+
+	struct cell {
+		std::atomic<std::size_t> sequence;
+		T value;
+	};
+
+	std::array<cell, Capacity> cells_;
+	alignas(cache_line) std::atomic<std::size_t> tail_ = 0;
+	alignas(cache_line) std::size_t head_ = 0;
+};
+
+} // namespace libvnc
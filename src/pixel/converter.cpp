@@ -0,0 +1,312 @@
+#include "converter.h"
+#include "kernels.h"
+#include <bit>
+#include <boost/endian/conversion.hpp>
+#include <cstring>
+
+namespace libvnc::pixel {
+
+namespace detail {
+
+constexpr bool host_big_endian = boost::endian::order::native == boost::endian::order::big;
+
+template<typename T> static inline T load(const uint8_t *p)
+{
+	T v;
+	std::memcpy(&v, p, sizeof(T));
+	return v;
+}
+
+template<typename T> static inline void store(uint8_t *p, T v)
+{
+	std::memcpy(p, &v, sizeof(T));
+}
+
+template<typename DstT> static void convert_lut8(const uint8_t *src, uint8_t *dst, int w, const uint32_t *lut)
+{
+	for (int i = 0; i < w; ++i)
+		store<DstT>(dst + i * sizeof(DstT), static_cast<DstT>(lut[src[i]]));
+}
+
+template<typename DstT> static void convert_lut16(const uint8_t *src, uint8_t *dst, int w, const uint32_t *lut)
+{
+	for (int i = 0; i < w; ++i)
+		store<DstT>(dst + i * sizeof(DstT), static_cast<DstT>(lut[load<uint16_t>(src + i * 2)]));
+}
+
+template<typename DstT>
+static void convert_table32(const uint8_t *src, uint8_t *dst, int w, bool swap_src,
+			    const converter::shift32_params &p, const std::array<const uint32_t *, 3> &channel)
+{
+	for (int i = 0; i < w; ++i) {
+		uint32_t v = load<uint32_t>(src + i * 4);
+		if (swap_src)
+			v = boost::endian::endian_reverse(v);
+
+		uint32_t out = channel[0][(v >> p.src_shift[0]) & p.mask[0]] |
+			       channel[1][(v >> p.src_shift[1]) & p.mask[1]] |
+			       channel[2][(v >> p.src_shift[2]) & p.mask[2]];
+		store<DstT>(dst + i * sizeof(DstT), static_cast<DstT>(out));
+	}
+}
+
+} // namespace detail
+
+bool converter::is_supported(const proto::rfbPixelFormat &format)
+{
+	auto bpp = format.bitsPerPixel.value();
+	if (bpp != 8 && bpp != 16 && bpp != 32)
+		return false;
+
+	/* colour-mapped formats are only handled as 8bpp indices */
+	return format.trueColour.value() != 0 || bpp == 8;
+}
+
+bool converter::same_format(const proto::rfbPixelFormat &a, const proto::rfbPixelFormat &b)
+{
+	if (a.bitsPerPixel.value() != b.bitsPerPixel.value() || a.trueColour.value() != b.trueColour.value())
+		return false;
+
+	if (!a.trueColour.value())
+		return true;
+
+	if (a.bitsPerPixel.value() > 8 && a.bigEndian.value() != b.bigEndian.value())
+		return false;
+
+	return a.redMax.value() == b.redMax.value() && a.greenMax.value() == b.greenMax.value() &&
+	       a.blueMax.value() == b.blueMax.value() && a.redShift.value() == b.redShift.value() &&
+	       a.greenShift.value() == b.greenShift.value() && a.blueShift.value() == b.blueShift.value();
+}
+
+proto::rfbPixelFormat converter::colour_map_format()
+{
+	proto::rfbPixelFormat format;
+	format.bitsPerPixel = 8;
+	format.depth = 8;
+	format.bigEndian = 0;
+	format.trueColour = 0;
+	return format;
+}
+
+proto::rfbPixelFormat converter::bgr233_format()
+{
+	proto::rfbPixelFormat format;
+	format.bitsPerPixel = 8;
+	format.depth = 8;
+	format.bigEndian = 0;
+	format.trueColour = 1;
+	format.redMax = 7;
+	format.greenMax = 7;
+	format.blueMax = 3;
+	format.redShift = 0;
+	format.greenShift = 3;
+	format.blueShift = 6;
+	return format;
+}
+
+proto::rfbPixelFormat converter::rgb565_format()
+{
+	proto::rfbPixelFormat format;
+	format.bitsPerPixel = 16;
+	format.depth = 16;
+	format.bigEndian = 0;
+	format.trueColour = 1;
+	format.redMax = 31;
+	format.greenMax = 63;
+	format.blueMax = 31;
+	format.redShift = 11;
+	format.greenShift = 5;
+	format.blueShift = 0;
+	return format;
+}
+
+void converter::set_formats(const proto::rfbPixelFormat &src, const proto::rfbPixelFormat &dst)
+{
+	src_ = src;
+	dst_ = dst;
+
+	identity_ = same_format(src, dst) || !is_supported(src) || !is_supported(dst) || !dst.trueColour.value();
+	if (identity_) {
+		kind_ = kind::identity;
+		lut16_.clear();
+		lut16_.shrink_to_fit();
+		return;
+	}
+
+	src_bytes_ = src.bytes_per_pixel();
+	dst_bytes_ = dst.bytes_per_pixel();
+	swap_src_ = src_bytes_ > 1 && (src.bigEndian.value() != 0) != detail::host_big_endian;
+
+	if (!src.trueColour.value()) {
+		kind_ = kind::lut8;
+		build_colour_map_lut();
+		return;
+	}
+
+	build_channel_tables();
+
+	shift32_.src_shift = {src.redShift.value(), src.greenShift.value(), src.blueShift.value()};
+	shift32_.dst_shift = {dst.redShift.value(), dst.greenShift.value(), dst.blueShift.value()};
+	shift32_.mask = {src.redMax.value(), src.greenMax.value(), src.blueMax.value()};
+	shift32_.swap_src = swap_src_;
+	shift32_.swap_dst = (dst.bigEndian.value() != 0) != detail::host_big_endian;
+
+	if (src_bytes_ == 1) {
+		kind_ = kind::lut8;
+		for (uint32_t i = 0; i < lut8_.size(); ++i)
+			lut8_[i] = compose(i);
+	} else if (src_bytes_ == 2 && build_expand16()) {
+		kind_ = kind::expand16;
+		lut16_.clear();
+		lut16_.shrink_to_fit();
+	} else if (src_bytes_ == 2) {
+		kind_ = kind::lut16;
+		lut16_.resize(1 << 16);
+		for (uint32_t i = 0; i < lut16_.size(); ++i) {
+			uint16_t v = static_cast<uint16_t>(i);
+			if (swap_src_)
+				v = boost::endian::endian_reverse(v);
+			lut16_[i] = compose(v);
+		}
+	} else {
+		bool same_max = src.redMax.value() == dst.redMax.value() &&
+				src.greenMax.value() == dst.greenMax.value() &&
+				src.blueMax.value() == dst.blueMax.value();
+		kind_ = (dst_bytes_ == 4 && same_max) ? kind::shift32 : kind::table32;
+	}
+}
+
+void converter::set_colour_map(int first, std::span<const proto::rfbColourMapEntry> entries)
+{
+	for (std::size_t i = 0; i < entries.size() && first + i < colour_map_.size(); ++i) {
+		const auto &entry = entries[i];
+		colour_map_[first + i] = {entry.red.value(), entry.green.value(), entry.blue.value()};
+	}
+	if (kind_ == kind::lut8 && !src_.trueColour.value())
+		build_colour_map_lut();
+}
+
+void converter::build_channel_tables()
+{
+	std::array<uint32_t, 3> src_max = {src_.redMax.value(), src_.greenMax.value(), src_.blueMax.value()};
+	std::array<uint32_t, 3> dst_max = {dst_.redMax.value(), dst_.greenMax.value(), dst_.blueMax.value()};
+	std::array<uint32_t, 3> dst_shift = {dst_.redShift.value(), dst_.greenShift.value(), dst_.blueShift.value()};
+
+	for (int c = 0; c < 3; ++c) {
+		auto &table = channel_[c];
+		table.resize(src_max[c] + 1);
+
+		for (uint32_t v = 0; v <= src_max[c]; ++v) {
+			uint32_t scaled = src_max[c] ? (v * dst_max[c] + src_max[c] / 2) / src_max[c] : 0;
+			table[v] = to_dst_order(scaled << dst_shift[c]);
+		}
+	}
+}
+
+bool converter::build_expand16()
+{
+	std::array<uint32_t, 3> src_max = {src_.redMax.value(), src_.greenMax.value(), src_.blueMax.value()};
+	std::array<uint32_t, 3> dst_max = {dst_.redMax.value(), dst_.greenMax.value(), dst_.blueMax.value()};
+
+	if (dst_bytes_ != 4)
+		return false;
+
+	for (int c = 0; c < 3; ++c) {
+		int bits = std::bit_width(src_max[c]);
+		if (dst_max[c] != 0xff || src_max[c] != (1u << bits) - 1 || bits < 4 || bits > 8)
+			return false;
+		expand16_.src_bits[c] = bits;
+	}
+	expand16_.src_shift = shift32_.src_shift;
+	expand16_.dst_shift = shift32_.dst_shift;
+	expand16_.swap_src = swap_src_;
+	expand16_.swap_dst = shift32_.swap_dst;
+	return true;
+}
+
+void converter::build_colour_map_lut()
+{
+	std::array<uint32_t, 3> dst_max = {dst_.redMax.value(), dst_.greenMax.value(), dst_.blueMax.value()};
+	std::array<uint32_t, 3> dst_shift = {dst_.redShift.value(), dst_.greenShift.value(), dst_.blueShift.value()};
+
+	for (std::size_t i = 0; i < lut8_.size(); ++i) {
+		uint32_t value = 0;
+		for (int c = 0; c < 3; ++c)
+			value |= ((colour_map_[i][c] * dst_max[c] + 32767) / 65535) << dst_shift[c];
+		lut8_[i] = to_dst_order(value);
+	}
+}
+
+uint32_t converter::to_dst_order(uint32_t value) const
+{
+	if (dst_bytes_ < 2 || (dst_.bigEndian.value() != 0) == detail::host_big_endian)
+		return value;
+	if (dst_bytes_ == 2)
+		return boost::endian::endian_reverse(static_cast<uint16_t>(value));
+	return boost::endian::endian_reverse(value);
+}
+
+uint32_t converter::compose(uint32_t value) const
+{
+	return channel_[0][(value >> src_.redShift.value()) & src_.redMax.value()] |
+	       channel_[1][(value >> src_.greenShift.value()) & src_.greenMax.value()] |
+	       channel_[2][(value >> src_.blueShift.value()) & src_.blueMax.value()];
+}
+
+void converter::convert_row(const uint8_t *src, uint8_t *dst, int w) const
+{
+	switch (kind_) {
+	case kind::identity: {
+		std::memcpy(dst, src, (std::size_t)w * src_.bytes_per_pixel());
+	} break;
+	case kind::lut8: {
+		if (dst_bytes_ == 1)
+			detail::convert_lut8<uint8_t>(src, dst, w, lut8_.data());
+		else if (dst_bytes_ == 2)
+			detail::convert_lut8<uint16_t>(src, dst, w, lut8_.data());
+		else
+			detail::convert_lut8<uint32_t>(src, dst, w, lut8_.data());
+	} break;
+	case kind::lut16: {
+		if (dst_bytes_ == 1)
+			detail::convert_lut16<uint8_t>(src, dst, w, lut16_.data());
+		else if (dst_bytes_ == 2)
+			detail::convert_lut16<uint16_t>(src, dst, w, lut16_.data());
+		else
+			detail::convert_lut16<uint32_t>(src, dst, w, lut16_.data());
+	} break;
+	case kind::expand16: {
+		kernels().expand16(src, dst, w, expand16_);
+	} break;
+	case kind::shift32: {
+		kernels().shift32(src, dst, w, shift32_);
+	} break;
+	case kind::table32: {
+		std::array<const uint32_t *, 3> channel = {channel_[0].data(), channel_[1].data(), channel_[2].data()};
+		if (dst_bytes_ == 1)
+			detail::convert_table32<uint8_t>(src, dst, w, swap_src_, shift32_, channel);
+		else if (dst_bytes_ == 2)
+			detail::convert_table32<uint16_t>(src, dst, w, swap_src_, shift32_, channel);
+		else
+			detail::convert_table32<uint32_t>(src, dst, w, swap_src_, shift32_, channel);
+	} break;
+	}
+}
+
+void converter::convert(const frame_buffer &src, frame_buffer &dst, const rect &r) const
+{
+	rect clip = r.intersected(rect{0, 0, std::min(src.width(), dst.width()), std::min(src.height(), dst.height())});
+	if (clip.empty())
+		return;
+
+	for (int i = 0; i < clip.h; ++i)
+		convert_row(src.data(clip.x, clip.y + i), dst.data(clip.x, clip.y + i), clip.w);
+}
+
+void converter::convert(const frame_buffer &src, frame_buffer &dst, const region &damage) const
+{
+	for (const auto &r : damage.rects())
+		convert(src, dst, r);
+}
+
+} // namespace libvnc::pixel
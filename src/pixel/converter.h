@@ -0,0 +1,81 @@
+#pragma once
+#include "libvnc-cpp/frame_buffer.h"
+#include "libvnc-cpp/proto.h"
+#include "libvnc-cpp/region.h"
+#include <array>
+#include <span>
+#include <vector>
+
+namespace libvnc::pixel {
+
+/** Converts pixels from the format the server puts on the wire into the format
+    the application asked for with want_format(). The tables are built once per
+    format change so that the per-pixel work is a lookup or a few shifts. */
+class converter {
+public:
+	static bool is_supported(const proto::rfbPixelFormat &format);
+	static bool same_format(const proto::rfbPixelFormat &a, const proto::rfbPixelFormat &b);
+	static proto::rfbPixelFormat colour_map_format();
+	static proto::rfbPixelFormat bgr233_format();
+	static proto::rfbPixelFormat rgb565_format();
+
+	void set_formats(const proto::rfbPixelFormat &src, const proto::rfbPixelFormat &dst);
+	void set_colour_map(int first, std::span<const proto::rfbColourMapEntry> entries);
+
+	bool is_identity() const { return identity_; }
+	const proto::rfbPixelFormat &src_format() const { return src_; }
+	const proto::rfbPixelFormat &dst_format() const { return dst_; }
+
+	void convert(const frame_buffer &src, frame_buffer &dst, const rect &r) const;
+	void convert(const frame_buffer &src, frame_buffer &dst, const region &damage) const;
+	void convert_row(const uint8_t *src, uint8_t *dst, int w) const;
+
+public:
+	struct shift32_params {
+		std::array<int, 3> src_shift{};
+		std::array<int, 3> dst_shift{};
+		std::array<uint32_t, 3> mask{};
+		bool swap_src = false;
+		bool swap_dst = false;
+	};
+
+	/* 16bpp channels of 4..8 bits widened to 8-bit channels by bit replication */
+	struct expand16_params {
+		std::array<int, 3> src_shift{};
+		std::array<int, 3> src_bits{};
+		std::array<int, 3> dst_shift{};
+		bool swap_src = false;
+		bool swap_dst = false;
+	};
+
+private:
+	enum class kind { identity, lut8, lut16, expand16, shift32, table32 };
+
+	void build_channel_tables();
+	void build_colour_map_lut();
+	bool build_expand16();
+	uint32_t compose(uint32_t value) const;
+	uint32_t to_dst_order(uint32_t value) const;
+
+private:
+	proto::rfbPixelFormat src_;
+	proto::rfbPixelFormat dst_;
+	bool identity_ = true;
+	kind kind_ = kind::identity;
+
+	bool swap_src_ = false;
+	uint8_t src_bytes_ = 4;
+	uint8_t dst_bytes_ = 4;
+
+	/* dst contribution of every src channel value, already shifted and byte-ordered for dst */
+	std::array<std::vector<uint32_t>, 3> channel_;
+	std::array<uint32_t, 256> lut8_{};
+	std::vector<uint32_t> lut16_;
+	shift32_params shift32_;
+	expand16_params expand16_;
+
+	/* 8bpp indexed mode: 16-bit RGB entries as sent by SetColourMapEntries */
+	std::array<std::array<uint16_t, 3>, 256> colour_map_{};
+};
+
+} // namespace libvnc::pixel
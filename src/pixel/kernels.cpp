@@ -0,0 +1,116 @@
+#include "kernels.h"
+#include <atomic>
+#include <boost/endian/conversion.hpp>
+#include <cstring>
+
+namespace libvnc::pixel {
+
+namespace detail {
+
+template<typename T> static inline T load(const uint8_t *p)
+{
+	T v;
+	std::memcpy(&v, p, sizeof(T));
+	return v;
+}
+
+template<typename T> static inline void store(uint8_t *p, T v)
+{
+	std::memcpy(p, &v, sizeof(T));
+}
+
+static inline uint32_t expand_channel(uint32_t v, int bits)
+{
+	return (v << (8 - bits)) | (v >> (2 * bits - 8));
+}
+
+void shift32_scalar(const uint8_t *src, uint8_t *dst, int w, const converter::shift32_params &p)
+{
+	for (int i = 0; i < w; ++i) {
+		uint32_t v = load<uint32_t>(src + i * 4);
+		if (p.swap_src)
+			v = boost::endian::endian_reverse(v);
+
+		uint32_t out = ((v >> p.src_shift[0]) & p.mask[0]) << p.dst_shift[0] |
+			       ((v >> p.src_shift[1]) & p.mask[1]) << p.dst_shift[1] |
+			       ((v >> p.src_shift[2]) & p.mask[2]) << p.dst_shift[2];
+		if (p.swap_dst)
+			out = boost::endian::endian_reverse(out);
+		store<uint32_t>(dst + i * 4, out);
+	}
+}
+
+void expand16_scalar(const uint8_t *src, uint8_t *dst, int w, const converter::expand16_params &p)
+{
+	for (int i = 0; i < w; ++i) {
+		uint32_t v = load<uint16_t>(src + i * 2);
+		if (p.swap_src)
+			v = boost::endian::endian_reverse(static_cast<uint16_t>(v));
+
+		uint32_t out = 0;
+		for (int c = 0; c < 3; ++c)
+			out |= expand_channel((v >> p.src_shift[c]) & ((1u << p.src_bits[c]) - 1), p.src_bits[c])
+			       << p.dst_shift[c];
+		if (p.swap_dst)
+			out = boost::endian::endian_reverse(out);
+		store<uint32_t>(dst + i * 4, out);
+	}
+}
+
+template<int Bpp> void fill_scalar(uint8_t *dst, int w, const uint8_t *colour)
+{
+	for (int i = 0; i < w; ++i)
+		std::memcpy(dst + i * Bpp, colour, Bpp);
+}
+
+template void fill_scalar<1>(uint8_t *, int, const uint8_t *);
+template void fill_scalar<2>(uint8_t *, int, const uint8_t *);
+template void fill_scalar<3>(uint8_t *, int, const uint8_t *);
+template void fill_scalar<4>(uint8_t *, int, const uint8_t *);
+
+const kernel_table scalar_kernels = {
+	simd::level::scalar,
+	shift32_scalar,
+	expand16_scalar,
+	{fill_scalar<1>, fill_scalar<2>, fill_scalar<3>, fill_scalar<4>},
+};
+
+static std::atomic<const kernel_table *> active_kernels{nullptr};
+
+static const kernel_table *table_for(simd::level level)
+{
+	switch (level) {
+#if defined(LIBVNC_ARCH_X86)
+	case simd::level::avx512:
+		return &avx512_kernels;
+	case simd::level::avx2:
+		return &avx2_kernels;
+	case simd::level::sse2:
+		return &sse2_kernels;
+#elif defined(LIBVNC_HAVE_NEON)
+	case simd::level::neon:
+		return &neon_kernels;
+#endif
+	default:
+		return &scalar_kernels;
+	}
+}
+
+} // namespace detail
+
+const kernel_table &kernels()
+{
+	auto table = detail::active_kernels.load(std::memory_order_acquire);
+	if (!table) [[unlikely]] {
+		select_kernels(simd::active_level());
+		table = detail::active_kernels.load(std::memory_order_acquire);
+	}
+	return *table;
+}
+
+void select_kernels(simd::level level)
+{
+	detail::active_kernels.store(detail::table_for(level), std::memory_order_release);
+}
+
+} // namespace libvnc::pixel
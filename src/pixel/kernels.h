@@ -0,0 +1,43 @@
+#pragma once
+#include "converter.h"
+#include "libvnc-cpp/simd.h"
+#include "simd.hpp"
+#include <array>
+
+namespace libvnc::pixel {
+
+using shift32_fn = void (*)(const uint8_t *src, uint8_t *dst, int w, const converter::shift32_params &p);
+using expand16_fn = void (*)(const uint8_t *src, uint8_t *dst, int w, const converter::expand16_params &p);
+using fill_fn = void (*)(uint8_t *dst, int w, const uint8_t *colour);
+
+/** One implementation of every vectorized pixel kernel. There is a table per
+    simd::level and the active one is swapped as a whole. */
+struct kernel_table {
+	simd::level level;
+	shift32_fn shift32;
+	expand16_fn expand16;
+	/* indexed by bytes per pixel - 1 */
+	std::array<fill_fn, 4> fill;
+};
+
+const kernel_table &kernels();
+void select_kernels(simd::level level);
+
+namespace detail {
+
+/* scalar reference kernels, also used for the tails of the vector loops */
+void shift32_scalar(const uint8_t *src, uint8_t *dst, int w, const converter::shift32_params &p);
+void expand16_scalar(const uint8_t *src, uint8_t *dst, int w, const converter::expand16_params &p);
+template<int Bpp> void fill_scalar(uint8_t *dst, int w, const uint8_t *colour);
+
+extern const kernel_table scalar_kernels;
+#if defined(LIBVNC_ARCH_X86)
+extern const kernel_table sse2_kernels;
+extern const kernel_table avx2_kernels;
+extern const kernel_table avx512_kernels;
+#elif defined(LIBVNC_HAVE_NEON)
+extern const kernel_table neon_kernels;
+#endif
+
+} // namespace detail
+} // namespace libvnc::pixel
@@ -0,0 +1,105 @@
+#include "kernels.h"
+
+#if defined(LIBVNC_HAVE_NEON)
+
+namespace libvnc::pixel::detail {
+
+static void shift32_neon(const uint8_t *src, uint8_t *dst, int w, const converter::shift32_params &p)
+{
+	int32x4_t src_shift[3], dst_shift[3];
+	uint32x4_t mask[3];
+	for (int c = 0; c < 3; ++c) {
+		src_shift[c] = vdupq_n_s32(-p.src_shift[c]);
+		dst_shift[c] = vdupq_n_s32(p.dst_shift[c]);
+		mask[c] = vdupq_n_u32(p.mask[c]);
+	}
+
+	int i = 0;
+	for (; i + 4 <= w; i += 4) {
+		uint32x4_t v = vld1q_u32(reinterpret_cast<const uint32_t *>(src + i * 4));
+		if (p.swap_src)
+			v = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(v)));
+
+		uint32x4_t out = vdupq_n_u32(0);
+		for (int c = 0; c < 3; ++c) {
+			uint32x4_t ch = vandq_u32(vshlq_u32(v, src_shift[c]), mask[c]);
+			out = vorrq_u32(out, vshlq_u32(ch, dst_shift[c]));
+		}
+		if (p.swap_dst)
+			out = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(out)));
+		vst1q_u32(reinterpret_cast<uint32_t *>(dst + i * 4), out);
+	}
+	shift32_scalar(src + i * 4, dst + i * 4, w - i, p);
+}
+
+static inline uint32x4_t expand16_neon_lanes(uint32x4_t v, const int32x4_t *src_shift, const uint32x4_t *mask,
+					     const int32x4_t *up, const int32x4_t *down, const int32x4_t *dst_shift)
+{
+	uint32x4_t out = vdupq_n_u32(0);
+	for (int c = 0; c < 3; ++c) {
+		uint32x4_t ch = vandq_u32(vshlq_u32(v, src_shift[c]), mask[c]);
+		ch = vorrq_u32(vshlq_u32(ch, up[c]), vshlq_u32(ch, down[c]));
+		out = vorrq_u32(out, vshlq_u32(ch, dst_shift[c]));
+	}
+	return out;
+}
+
+static void expand16_neon(const uint8_t *src, uint8_t *dst, int w, const converter::expand16_params &p)
+{
+	int32x4_t src_shift[3], up[3], down[3], dst_shift[3];
+	uint32x4_t mask[3];
+	for (int c = 0; c < 3; ++c) {
+		src_shift[c] = vdupq_n_s32(-p.src_shift[c]);
+		mask[c] = vdupq_n_u32((1u << p.src_bits[c]) - 1);
+		up[c] = vdupq_n_s32(8 - p.src_bits[c]);
+		down[c] = vdupq_n_s32(8 - 2 * p.src_bits[c]);
+		dst_shift[c] = vdupq_n_s32(p.dst_shift[c]);
+	}
+
+	int i = 0;
+	for (; i + 8 <= w; i += 8) {
+		uint16x8_t v = vld1q_u16(reinterpret_cast<const uint16_t *>(src + i * 2));
+		if (p.swap_src)
+			v = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(v)));
+
+		uint32x4_t lo = expand16_neon_lanes(vmovl_u16(vget_low_u16(v)), src_shift, mask, up, down, dst_shift);
+		uint32x4_t hi = expand16_neon_lanes(vmovl_u16(vget_high_u16(v)), src_shift, mask, up, down, dst_shift);
+		if (p.swap_dst) {
+			lo = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(lo)));
+			hi = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(hi)));
+		}
+		vst1q_u32(reinterpret_cast<uint32_t *>(dst + i * 4), lo);
+		vst1q_u32(reinterpret_cast<uint32_t *>(dst + i * 4 + 16), hi);
+	}
+	expand16_scalar(src + i * 2, dst + i * 4, w - i, p);
+}
+
+template<int Bpp> static void fill_neon(uint8_t *dst, int w, const uint8_t *colour)
+{
+	int i = 0;
+	if constexpr (Bpp == 3) {
+		uint8x16x3_t v = {{vdupq_n_u8(colour[0]), vdupq_n_u8(colour[1]), vdupq_n_u8(colour[2])}};
+		for (; i + 16 <= w; i += 16)
+			vst3q_u8(dst + i * 3, v);
+	} else {
+		uint8_t bytes[16];
+		for (int k = 0; k < 16; ++k)
+			bytes[k] = colour[k % Bpp];
+		uint8x16_t v = vld1q_u8(bytes);
+		constexpr int step = 16 / Bpp;
+		for (; i + step <= w; i += step)
+			vst1q_u8(dst + i * Bpp, v);
+	}
+	fill_scalar<Bpp>(dst + i * Bpp, w - i, colour);
+}
+
+const kernel_table neon_kernels = {
+	simd::level::neon,
+	shift32_neon,
+	expand16_neon,
+	{fill_neon<1>, fill_neon<2>, fill_neon<3>, fill_neon<4>},
+};
+
+} // namespace libvnc::pixel::detail
+
+#endif
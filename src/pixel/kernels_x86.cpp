@@ -0,0 +1,339 @@
+#include "kernels.h"
+
+#if defined(LIBVNC_ARCH_X86)
+#include <cstring>
+
+namespace libvnc::pixel::detail {
+
+/* the colour repeated over 4 bytes, for 1, 2 and 4 byte pixels */
+static inline uint32_t splat32(const uint8_t *colour, int bpp)
+{
+	uint8_t bytes[4];
+	for (int i = 0; i < 4; ++i)
+		bytes[i] = colour[i % bpp];
+	uint32_t v;
+	std::memcpy(&v, bytes, sizeof(v));
+	return v;
+}
+
+/* SSE2 */
+
+LIBVNC_TARGET("sse2") static inline __m128i bswap32_sse2(__m128i v)
+{
+	v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+LIBVNC_TARGET("sse2")
+static void shift32_sse2(const uint8_t *src, uint8_t *dst, int w, const converter::shift32_params &p)
+{
+	__m128i src_shift[3], dst_shift[3], mask[3];
+	for (int c = 0; c < 3; ++c) {
+		src_shift[c] = _mm_cvtsi32_si128(p.src_shift[c]);
+		dst_shift[c] = _mm_cvtsi32_si128(p.dst_shift[c]);
+		mask[c] = _mm_set1_epi32(static_cast<int>(p.mask[c]));
+	}
+
+	int i = 0;
+	for (; i + 4 <= w; i += 4) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+		if (p.swap_src)
+			v = bswap32_sse2(v);
+
+		__m128i out = _mm_setzero_si128();
+		for (int c = 0; c < 3; ++c) {
+			__m128i ch = _mm_and_si128(_mm_srl_epi32(v, src_shift[c]), mask[c]);
+			out = _mm_or_si128(out, _mm_sll_epi32(ch, dst_shift[c]));
+		}
+		if (p.swap_dst)
+			out = bswap32_sse2(out);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), out);
+	}
+	shift32_scalar(src + i * 4, dst + i * 4, w - i, p);
+}
+
+LIBVNC_TARGET("sse2")
+static inline __m128i expand16_sse2_lanes(__m128i v, const __m128i *src_shift, const __m128i *mask, const __m128i *up,
+					  const __m128i *down, const __m128i *dst_shift)
+{
+	__m128i out = _mm_setzero_si128();
+	for (int c = 0; c < 3; ++c) {
+		__m128i ch = _mm_and_si128(_mm_srl_epi32(v, src_shift[c]), mask[c]);
+		ch = _mm_or_si128(_mm_sll_epi32(ch, up[c]), _mm_srl_epi32(ch, down[c]));
+		out = _mm_or_si128(out, _mm_sll_epi32(ch, dst_shift[c]));
+	}
+	return out;
+}
+
+LIBVNC_TARGET("sse2")
+static void expand16_sse2(const uint8_t *src, uint8_t *dst, int w, const converter::expand16_params &p)
+{
+	__m128i src_shift[3], mask[3], up[3], down[3], dst_shift[3];
+	for (int c = 0; c < 3; ++c) {
+		src_shift[c] = _mm_cvtsi32_si128(p.src_shift[c]);
+		mask[c] = _mm_set1_epi32((1 << p.src_bits[c]) - 1);
+		up[c] = _mm_cvtsi32_si128(8 - p.src_bits[c]);
+		down[c] = _mm_cvtsi32_si128(2 * p.src_bits[c] - 8);
+		dst_shift[c] = _mm_cvtsi32_si128(p.dst_shift[c]);
+	}
+
+	const __m128i zero = _mm_setzero_si128();
+	int i = 0;
+	for (; i + 8 <= w; i += 8) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2));
+		if (p.swap_src)
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+
+		__m128i lo = expand16_sse2_lanes(_mm_unpacklo_epi16(v, zero), src_shift, mask, up, down, dst_shift);
+		__m128i hi = expand16_sse2_lanes(_mm_unpackhi_epi16(v, zero), src_shift, mask, up, down, dst_shift);
+		if (p.swap_dst) {
+			lo = bswap32_sse2(lo);
+			hi = bswap32_sse2(hi);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), lo);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4 + 16), hi);
+	}
+	expand16_scalar(src + i * 2, dst + i * 4, w - i, p);
+}
+
+/* 3-byte pixels repeat a 48-byte pattern, the smallest multiple of both sizes */
+template<int Bpp> LIBVNC_TARGET("sse2") static void fill_sse2(uint8_t *dst, int w, const uint8_t *colour)
+{
+	int i = 0;
+	if constexpr (Bpp == 3) {
+		alignas(16) uint8_t pattern[48];
+		for (int k = 0; k < 48; ++k)
+			pattern[k] = colour[k % 3];
+		__m128i p0 = _mm_load_si128(reinterpret_cast<const __m128i *>(pattern));
+		__m128i p1 = _mm_load_si128(reinterpret_cast<const __m128i *>(pattern + 16));
+		__m128i p2 = _mm_load_si128(reinterpret_cast<const __m128i *>(pattern + 32));
+		for (; i + 16 <= w; i += 16) {
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 3), p0);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 3 + 16), p1);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 3 + 32), p2);
+		}
+	} else {
+		__m128i v = _mm_set1_epi32(static_cast<int>(splat32(colour, Bpp)));
+		constexpr int step = 16 / Bpp;
+		for (; i + step <= w; i += step)
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * Bpp), v);
+	}
+	fill_scalar<Bpp>(dst + i * Bpp, w - i, colour);
+}
+
+/* AVX2 */
+
+LIBVNC_TARGET("avx2") static inline __m256i bswap32_avx2(__m256i v)
+{
+	const __m256i order = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6,
+					       5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	return _mm256_shuffle_epi8(v, order);
+}
+
+LIBVNC_TARGET("avx2")
+static void shift32_avx2(const uint8_t *src, uint8_t *dst, int w, const converter::shift32_params &p)
+{
+	__m128i src_shift[3], dst_shift[3];
+	__m256i mask[3];
+	for (int c = 0; c < 3; ++c) {
+		src_shift[c] = _mm_cvtsi32_si128(p.src_shift[c]);
+		dst_shift[c] = _mm_cvtsi32_si128(p.dst_shift[c]);
+		mask[c] = _mm256_set1_epi32(static_cast<int>(p.mask[c]));
+	}
+
+	int i = 0;
+	for (; i + 8 <= w; i += 8) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4));
+		if (p.swap_src)
+			v = bswap32_avx2(v);
+
+		__m256i out = _mm256_setzero_si256();
+		for (int c = 0; c < 3; ++c) {
+			__m256i ch = _mm256_and_si256(_mm256_srl_epi32(v, src_shift[c]), mask[c]);
+			out = _mm256_or_si256(out, _mm256_sll_epi32(ch, dst_shift[c]));
+		}
+		if (p.swap_dst)
+			out = bswap32_avx2(out);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), out);
+	}
+	shift32_scalar(src + i * 4, dst + i * 4, w - i, p);
+}
+
+LIBVNC_TARGET("avx2")
+static void expand16_avx2(const uint8_t *src, uint8_t *dst, int w, const converter::expand16_params &p)
+{
+	__m128i src_shift[3], up[3], down[3], dst_shift[3];
+	__m256i mask[3];
+	for (int c = 0; c < 3; ++c) {
+		src_shift[c] = _mm_cvtsi32_si128(p.src_shift[c]);
+		mask[c] = _mm256_set1_epi32((1 << p.src_bits[c]) - 1);
+		up[c] = _mm_cvtsi32_si128(8 - p.src_bits[c]);
+		down[c] = _mm_cvtsi32_si128(2 * p.src_bits[c] - 8);
+		dst_shift[c] = _mm_cvtsi32_si128(p.dst_shift[c]);
+	}
+	const __m128i swap16 = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+	int i = 0;
+	for (; i + 8 <= w; i += 8) {
+		__m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2));
+		if (p.swap_src)
+			packed = _mm_shuffle_epi8(packed, swap16);
+		__m256i v = _mm256_cvtepu16_epi32(packed);
+
+		__m256i out = _mm256_setzero_si256();
+		for (int c = 0; c < 3; ++c) {
+			__m256i ch = _mm256_and_si256(_mm256_srl_epi32(v, src_shift[c]), mask[c]);
+			ch = _mm256_or_si256(_mm256_sll_epi32(ch, up[c]), _mm256_srl_epi32(ch, down[c]));
+			out = _mm256_or_si256(out, _mm256_sll_epi32(ch, dst_shift[c]));
+		}
+		if (p.swap_dst)
+			out = bswap32_avx2(out);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), out);
+	}
+	expand16_scalar(src + i * 2, dst + i * 4, w - i, p);
+}
+
+template<int Bpp> LIBVNC_TARGET("avx2") static void fill_avx2(uint8_t *dst, int w, const uint8_t *colour)
+{
+	int i = 0;
+	if constexpr (Bpp == 3) {
+		alignas(32) uint8_t pattern[96];
+		for (int k = 0; k < 96; ++k)
+			pattern[k] = colour[k % 3];
+		__m256i p0 = _mm256_load_si256(reinterpret_cast<const __m256i *>(pattern));
+		__m256i p1 = _mm256_load_si256(reinterpret_cast<const __m256i *>(pattern + 32));
+		__m256i p2 = _mm256_load_si256(reinterpret_cast<const __m256i *>(pattern + 64));
+		for (; i + 32 <= w; i += 32) {
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 3), p0);
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 3 + 32), p1);
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 3 + 64), p2);
+		}
+	} else {
+		__m256i v = _mm256_set1_epi32(static_cast<int>(splat32(colour, Bpp)));
+		constexpr int step = 32 / Bpp;
+		for (; i + step <= w; i += step)
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * Bpp), v);
+	}
+	fill_scalar<Bpp>(dst + i * Bpp, w - i, colour);
+}
+
+/* AVX-512 (F + BW) */
+
+LIBVNC_TARGET("avx512f,avx512bw") static inline __m512i bswap32_avx512(__m512i v)
+{
+	const __m512i order = _mm512_broadcast_i32x4(
+		_mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+	return _mm512_shuffle_epi8(v, order);
+}
+
+LIBVNC_TARGET("avx512f,avx512bw")
+static void shift32_avx512(const uint8_t *src, uint8_t *dst, int w, const converter::shift32_params &p)
+{
+	__m128i src_shift[3], dst_shift[3];
+	__m512i mask[3];
+	for (int c = 0; c < 3; ++c) {
+		src_shift[c] = _mm_cvtsi32_si128(p.src_shift[c]);
+		dst_shift[c] = _mm_cvtsi32_si128(p.dst_shift[c]);
+		mask[c] = _mm512_set1_epi32(static_cast<int>(p.mask[c]));
+	}
+
+	int i = 0;
+	for (; i + 16 <= w; i += 16) {
+		__m512i v = _mm512_loadu_si512(src + i * 4);
+		if (p.swap_src)
+			v = bswap32_avx512(v);
+
+		__m512i out = _mm512_setzero_si512();
+		for (int c = 0; c < 3; ++c) {
+			__m512i ch = _mm512_and_si512(_mm512_srl_epi32(v, src_shift[c]), mask[c]);
+			out = _mm512_or_si512(out, _mm512_sll_epi32(ch, dst_shift[c]));
+		}
+		if (p.swap_dst)
+			out = bswap32_avx512(out);
+		_mm512_storeu_si512(dst + i * 4, out);
+	}
+	shift32_scalar(src + i * 4, dst + i * 4, w - i, p);
+}
+
+LIBVNC_TARGET("avx512f,avx512bw")
+static void expand16_avx512(const uint8_t *src, uint8_t *dst, int w, const converter::expand16_params &p)
+{
+	__m128i src_shift[3], up[3], down[3], dst_shift[3];
+	__m512i mask[3];
+	for (int c = 0; c < 3; ++c) {
+		src_shift[c] = _mm_cvtsi32_si128(p.src_shift[c]);
+		mask[c] = _mm512_set1_epi32((1 << p.src_bits[c]) - 1);
+		up[c] = _mm_cvtsi32_si128(8 - p.src_bits[c]);
+		down[c] = _mm_cvtsi32_si128(2 * p.src_bits[c] - 8);
+		dst_shift[c] = _mm_cvtsi32_si128(p.dst_shift[c]);
+	}
+
+	int i = 0;
+	for (; i + 16 <= w; i += 16) {
+		__m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 2));
+		if (p.swap_src)
+			packed = _mm256_or_si256(_mm256_slli_epi16(packed, 8), _mm256_srli_epi16(packed, 8));
+		__m512i v = _mm512_cvtepu16_epi32(packed);
+
+		__m512i out = _mm512_setzero_si512();
+		for (int c = 0; c < 3; ++c) {
+			__m512i ch = _mm512_and_si512(_mm512_srl_epi32(v, src_shift[c]), mask[c]);
+			ch = _mm512_or_si512(_mm512_sll_epi32(ch, up[c]), _mm512_srl_epi32(ch, down[c]));
+			out = _mm512_or_si512(out, _mm512_sll_epi32(ch, dst_shift[c]));
+		}
+		if (p.swap_dst)
+			out = bswap32_avx512(out);
+		_mm512_storeu_si512(dst + i * 4, out);
+	}
+	expand16_scalar(src + i * 2, dst + i * 4, w - i, p);
+}
+
+template<int Bpp> LIBVNC_TARGET("avx512f,avx512bw") static void fill_avx512(uint8_t *dst, int w, const uint8_t *colour)
+{
+	int i = 0;
+	if constexpr (Bpp == 3) {
+		alignas(64) uint8_t pattern[192];
+		for (int k = 0; k < 192; ++k)
+			pattern[k] = colour[k % 3];
+		__m512i p0 = _mm512_load_si512(pattern);
+		__m512i p1 = _mm512_load_si512(pattern + 64);
+		__m512i p2 = _mm512_load_si512(pattern + 128);
+		for (; i + 64 <= w; i += 64) {
+			_mm512_storeu_si512(dst + i * 3, p0);
+			_mm512_storeu_si512(dst + i * 3 + 64, p1);
+			_mm512_storeu_si512(dst + i * 3 + 128, p2);
+		}
+	} else {
+		__m512i v = _mm512_set1_epi32(static_cast<int>(splat32(colour, Bpp)));
+		constexpr int step = 64 / Bpp;
+		for (; i + step <= w; i += step)
+			_mm512_storeu_si512(dst + i * Bpp, v);
+	}
+	fill_scalar<Bpp>(dst + i * Bpp, w - i, colour);
+}
+
+const kernel_table sse2_kernels = {
+	simd::level::sse2,
+	shift32_sse2,
+	expand16_sse2,
+	{fill_sse2<1>, fill_sse2<2>, fill_sse2<3>, fill_sse2<4>},
+};
+
+const kernel_table avx2_kernels = {
+	simd::level::avx2,
+	shift32_avx2,
+	expand16_avx2,
+	{fill_avx2<1>, fill_avx2<2>, fill_avx2<3>, fill_avx2<4>},
+};
+
+const kernel_table avx512_kernels = {
+	simd::level::avx512,
+	shift32_avx512,
+	expand16_avx512,
+	{fill_avx512<1>, fill_avx512<2>, fill_avx512<3>, fill_avx512<4>},
+};
+
+} // namespace libvnc::pixel::detail
+
+#endif
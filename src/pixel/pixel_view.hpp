@@ -0,0 +1,136 @@
+#pragma once
+#include "libvnc-cpp/frame_buffer.h"
+#include "kernels.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
+
+namespace libvnc::pixel {
+
+/* packed 3-byte pixel, kept in the frame's own byte order */
+struct pixel24 {
+	std::array<uint8_t, 3> bytes{};
+};
+
+template<int Bpp> struct pixel_type;
+template<> struct pixel_type<1> {
+	using type = uint8_t;
+};
+template<> struct pixel_type<2> {
+	using type = uint16_t;
+};
+template<> struct pixel_type<3> {
+	using type = pixel24;
+};
+template<> struct pixel_type<4> {
+	using type = uint32_t;
+};
+template<int Bpp> using pixel_t = typename pixel_type<Bpp>::type;
+
+template<typename T> static inline T load_pixel(const uint8_t *p)
+{
+	T v;
+	std::memcpy(&v, p, sizeof(T));
+	return v;
+}
+
+template<typename T> static inline void store_pixel(uint8_t *p, const T &v)
+{
+	std::memcpy(p, &v, sizeof(T));
+}
+
+/* rows at least this wide go through the runtime-selected vector kernel */
+constexpr int wide_fill_pixels = 16;
+
+/** Fills w pixels starting at dst. Narrow rows are filled inline; wide ones go
+    through the kernels picked for the running CPU. */
+template<typename T> static inline void fill_row(uint8_t *dst, int w, const T &colour)
+{
+	static_assert(sizeof(T) >= 1 && sizeof(T) <= 4);
+	if (w >= wide_fill_pixels) {
+		kernels().fill[sizeof(T) - 1](dst, w, reinterpret_cast<const uint8_t *>(&colour));
+		return;
+	}
+	for (int i = 0; i < w; ++i)
+		store_pixel<T>(dst + i * sizeof(T), colour);
+}
+
+/** A typed window onto a rect of pixels. Codecs instantiate it once per rect
+    so the per-pixel work never looks at the pixel format again. */
+template<typename T> class pixel_view {
+public:
+	pixel_view(uint8_t *base, std::size_t stride, int w, int h)
+		: base_(base)
+		, stride_(stride)
+		, width_(w)
+		, height_(h)
+	{
+	}
+	/* the rect must already have passed frame_buffer::check_rect */
+	pixel_view(frame_buffer &frame, int x, int y, int w, int h)
+		: pixel_view(frame.data(x, y), frame.bytes_per_line(), w, h)
+	{
+	}
+
+	int width() const { return width_; }
+	int height() const { return height_; }
+
+	uint8_t *row(int y) { return base_ + stride_ * y; }
+	const uint8_t *row(int y) const { return base_ + stride_ * y; }
+
+	T get(int x, int y) const { return load_pixel<T>(row(y) + x * sizeof(T)); }
+	void set(int x, int y, const T &v) { store_pixel<T>(row(y) + x * sizeof(T), v); }
+
+	void fill(int x, int y, int w, int h, const T &v)
+	{
+		for (int i = 0; i < h; ++i)
+			fill_row<T>(row(y + i) + x * sizeof(T), w, v);
+	}
+	void fill(const T &v) { fill(0, 0, width_, height_, v); }
+
+	/* writes a run of pixels in raster order starting at (x, y), wrapping at the right edge */
+	void run(int &x, int &y, int length, const T &v)
+	{
+		while (length > 0 && y < height_) {
+			int n = std::min(length, width_ - x);
+			fill_row<T>(row(y) + x * sizeof(T), n, v);
+			length -= n;
+			x += n;
+			if (x >= width_) {
+				x = 0;
+				++y;
+			}
+		}
+	}
+
+private:
+	uint8_t *base_;
+	std::size_t stride_;
+	int width_;
+	int height_;
+};
+
+/** Calls f(std::type_identity<T>{}) with the pixel type for bytes_per_pixel.
+    Returns false when there is no kernel for that size. */
+template<typename F> static inline bool dispatch_bpp(int bytes_per_pixel, F &&f)
+{
+	switch (bytes_per_pixel) {
+	case 1:
+		f(std::type_identity<pixel_t<1>>{});
+		return true;
+	case 2:
+		f(std::type_identity<pixel_t<2>>{});
+		return true;
+	case 3:
+		f(std::type_identity<pixel_t<3>>{});
+		return true;
+	case 4:
+		f(std::type_identity<pixel_t<4>>{});
+		return true;
+	default:
+		return false;
+	}
+}
+
+} // namespace libvnc::pixel
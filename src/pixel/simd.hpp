@@ -0,0 +1,17 @@
+#pragma once
+
+/* Kernels for every instruction set are compiled into the same binary and
+   picked at runtime, so x86 code is built with per-function target attributes
+   instead of global -m flags. MSVC accepts the intrinsics without them. */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define LIBVNC_ARCH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define LIBVNC_TARGET(features)
+#else
+#define LIBVNC_TARGET(features) __attribute__((target(features)))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define LIBVNC_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
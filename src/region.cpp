@@ -0,0 +1,137 @@
+#include "libvnc-cpp/region.h"
+#include <algorithm>
+
+namespace libvnc {
+
+bool rect::contains(const rect &other) const
+{
+	if (other.empty())
+		return true;
+	return other.x >= x && other.y >= y && other.right() <= right() && other.bottom() <= bottom();
+}
+
+bool rect::intersects(const rect &other) const
+{
+	return !intersected(other).empty();
+}
+
+rect rect::intersected(const rect &other) const
+{
+	rect r;
+	r.x = std::max(x, other.x);
+	r.y = std::max(y, other.y);
+	r.w = std::min(right(), other.right()) - r.x;
+	r.h = std::min(bottom(), other.bottom()) - r.y;
+	if (r.empty())
+		return rect{};
+	return r;
+}
+
+rect rect::united(const rect &other) const
+{
+	if (empty())
+		return other;
+	if (other.empty())
+		return *this;
+
+	rect r;
+	r.x = std::min(x, other.x);
+	r.y = std::min(y, other.y);
+	r.w = std::max(right(), other.right()) - r.x;
+	r.h = std::max(bottom(), other.bottom()) - r.y;
+	return r;
+}
+
+void region::add(const rect &r)
+{
+	if (r.empty())
+		return;
+
+	for (const auto &item : rects_) {
+		if (item.contains(r))
+			return;
+	}
+	bounds_ = bounds_.united(r);
+
+	rect merged = r;
+	for (bool again = true; again;) {
+		again = false;
+		for (auto iter = rects_.begin(); iter != rects_.end(); ++iter) {
+			const auto &item = *iter;
+			bool same_row = item.y == merged.y && item.h == merged.h && item.x <= merged.right() &&
+					merged.x <= item.right();
+			bool same_column = item.x == merged.x && item.w == merged.w && item.y <= merged.bottom() &&
+					   merged.y <= item.bottom();
+			if (same_row || same_column || merged.contains(item)) {
+				merged = merged.united(item);
+				rects_.erase(iter);
+				again = true;
+				break;
+			}
+		}
+	}
+	rects_.push_back(merged);
+
+	if (rects_.size() > max_rects) {
+		rects_.clear();
+		rects_.push_back(bounds_);
+	}
+}
+
+void region::add(const region &other)
+{
+	for (const auto &r : other.rects_)
+		add(r);
+}
+
+void region::subtract(const rect &r)
+{
+	if (r.empty() || !bounds_.intersects(r))
+		return;
+
+	auto old = std::move(rects_);
+	clear();
+	for (const auto &item : old) {
+		auto cut = item.intersected(r);
+		if (cut.empty()) {
+			add(item);
+			continue;
+		}
+		/* what is left of item around cut: full-width bands above and below, then the sides */
+		add(rect{item.x, item.y, item.w, cut.y - item.y});
+		add(rect{item.x, cut.bottom(), item.w, item.bottom() - cut.bottom()});
+		add(rect{item.x, cut.y, cut.x - item.x, cut.h});
+		add(rect{cut.right(), cut.y, item.right() - cut.right(), cut.h});
+	}
+}
+
+void region::clear()
+{
+	rects_.clear();
+	bounds_ = rect{};
+}
+
+bool region::empty() const
+{
+	return rects_.empty();
+}
+
+rect region::bounds() const
+{
+	return bounds_;
+}
+
+std::size_t region::area() const
+{
+	std::size_t total = 0;
+	for (const auto &r : rects_)
+		total += r.area();
+	return total;
+}
+
+const std::vector<rect> &region::rects() const
+{
+	return rects_;
+}
+
+} // namespace libvnc
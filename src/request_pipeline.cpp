@@ -0,0 +1,84 @@
+#include "request_pipeline.hpp"
+#include <algorithm>
+
+namespace libvnc {
+
+void request_pipeline::set_max_depth(int depth)
+{
+	max_depth_ = std::clamp(depth, 1, 8);
+}
+
+int request_pipeline::max_depth() const
+{
+	return max_depth_;
+}
+
+void request_pipeline::reset()
+{
+	sent_.clear();
+	latency_count_ = 0;
+	latency_next_ = 0;
+	decode_time_ = {};
+	update_start_ = {};
+}
+
+void request_pipeline::on_request_sent(clock::time_point now)
+{
+	sent_.push_back(now);
+}
+
+void request_pipeline::on_update_begin(clock::time_point now)
+{
+	update_start_ = now;
+
+	/* unsolicited updates (e.g. continuous updates) have no request to match */
+	if (sent_.empty())
+		return;
+
+	latency_[latency_next_] = now - sent_.front();
+	latency_next_ = (latency_next_ + 1) % latency_window;
+	latency_count_ = std::min(latency_count_ + 1, latency_window);
+	/* servers merge pending requests into the next update, so it answers all of them */
+	sent_.clear();
+}
+
+void request_pipeline::on_update_end(clock::duration read_wait, clock::time_point now)
+{
+	auto elapsed = std::max<clock::duration>(now - update_start_ - read_wait, {});
+	/* moving average, 1/8 weight for the new sample */
+	if (decode_time_ == clock::duration::zero())
+		decode_time_ = elapsed;
+	else
+		decode_time_ += (elapsed - decode_time_) / 8;
+}
+
+int request_pipeline::outstanding() const
+{
+	return static_cast<int>(sent_.size());
+}
+
+int request_pipeline::target_depth() const
+{
+	int max_depth = max_depth_;
+	if (max_depth <= 1 || latency_count_ == 0)
+		return max_depth;
+
+	/* enough requests in flight to cover one round trip while updates are being decoded */
+	auto decode = std::max<clock::duration>(decode_time_, std::chrono::milliseconds(1));
+	auto depth = 1 + (min_latency() + decode - clock::duration(1)) / decode;
+	return static_cast<int>(std::clamp<clock::rep>(depth, 1, max_depth));
+}
+
+request_pipeline::clock::duration request_pipeline::min_latency() const
+{
+	if (latency_count_ == 0)
+		return {};
+	return *std::min_element(latency_.begin(), latency_.begin() + latency_count_);
+}
+
+request_pipeline::clock::duration request_pipeline::decode_time() const
+{
+	return decode_time_;
+}
+
+} // namespace libvnc
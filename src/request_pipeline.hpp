@@ -0,0 +1,46 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+
+namespace libvnc {
+
+/** Bookkeeping for FramebufferUpdateRequests that are in flight.
+    With a depth above one the next request goes out when an update header
+    arrives, so the server prepares the following update while we decode.
+    The depth in use is derived from the lowest recent request latency and
+    the decode time, and never exceeds max_depth(). An update counts as the
+    answer to every request sent before it arrived. */
+class request_pipeline {
+public:
+	using clock = std::chrono::steady_clock;
+
+	void set_max_depth(int depth);
+	int max_depth() const;
+	void reset();
+
+	void on_request_sent(clock::time_point now = clock::now());
+	void on_update_begin(clock::time_point now = clock::now());
+	/** read_wait is the time spent waiting on the socket during the update, which is not decoding */
+	void on_update_end(clock::duration read_wait, clock::time_point now = clock::now());
+
+	int outstanding() const;
+	int target_depth() const;
+
+	clock::duration min_latency() const;
+	clock::duration decode_time() const;
+
+private:
+	constexpr static std::size_t latency_window = 16;
+
+	std::atomic_int max_depth_ = 1;
+	std::deque<clock::time_point> sent_;
+	std::array<clock::duration, latency_window> latency_{};
+	std::size_t latency_count_ = 0;
+	std::size_t latency_next_ = 0;
+	clock::duration decode_time_{};
+	clock::time_point update_start_{};
+};
+
+} // namespace libvnc
@@ -0,0 +1,97 @@
+#include "send_buffer.hpp"
+
+namespace libvnc {
+
+bool send_buffer::append(uint8_t id, std::span<const boost::asio::const_buffer> parts, priority prio,
+			 uint32_t merge_tag)
+{
+	std::lock_guard lck(mutex_);
+	auto &pending = pending_[static_cast<std::size_t>(prio)];
+	auto size = sizeof(id) + boost::asio::buffer_size(parts);
+	if (prio == priority::input && merge_tag != 0 && merge_tag == last_tag_ &&
+	    pending.size() - last_offset_ == size) {
+		/* still waiting behind the write in flight, only the newest copy matters */
+		boost::asio::buffer_copy(boost::asio::buffer(pending.data() + last_offset_ + sizeof(id),
+							     size - sizeof(id)),
+					 parts);
+		return false;
+	}
+
+	auto offset = pending.size();
+	if (prio == priority::input) {
+		last_offset_ = offset;
+		last_tag_ = merge_tag;
+	} else if (prio == priority::bulk) {
+		bulk_sizes_.push_back(size);
+	}
+	pending.resize(offset + size);
+	pending[offset] = id;
+	boost::asio::buffer_copy(boost::asio::buffer(pending.data() + offset + sizeof(id), size - sizeof(id)),
+				 parts);
+	return !std::exchange(busy_, true);
+}
+
+std::span<const uint8_t> send_buffer::take()
+{
+	std::lock_guard lck(mutex_);
+	if (writing_.capacity() > retained_capacity)
+		writing_ = std::vector<uint8_t>{};
+	writing_.clear();
+	last_tag_ = 0;
+
+	for (auto prio : {priority::input, priority::control}) {
+		auto &pending = pending_[static_cast<std::size_t>(prio)];
+		writing_.insert(writing_.end(), pending.begin(), pending.end());
+		pending.clear();
+	}
+
+	/* whole bulk messages, at least one, up to a chunk per write */
+	auto &bulk = pending_[static_cast<std::size_t>(priority::bulk)];
+	std::size_t taken = 0;
+	while (!bulk_sizes_.empty() && (taken == 0 || taken + bulk_sizes_.front() <= bulk_chunk)) {
+		taken += bulk_sizes_.front();
+		bulk_sizes_.pop_front();
+	}
+	if (taken > 0) {
+		auto begin = bulk.begin() + static_cast<std::ptrdiff_t>(bulk_read_);
+		writing_.insert(writing_.end(), begin, begin + static_cast<std::ptrdiff_t>(taken));
+		bulk_read_ += taken;
+		if (bulk_read_ == bulk.size()) {
+			bulk.clear();
+			bulk_read_ = 0;
+			if (bulk.capacity() > retained_capacity)
+				bulk = std::vector<uint8_t>{};
+		} else if (bulk_read_ * 2 > bulk.size()) {
+			bulk.erase(bulk.begin(), bulk.begin() + static_cast<std::ptrdiff_t>(bulk_read_));
+			bulk_read_ = 0;
+		}
+	}
+
+	if (writing_.empty())
+		busy_ = false;
+	return writing_;
+}
+
+void send_buffer::abort()
+{
+	std::lock_guard lck(mutex_);
+	clear_pending();
+	busy_ = false;
+}
+
+void send_buffer::clear()
+{
+	std::lock_guard lck(mutex_);
+	clear_pending();
+}
+
+void send_buffer::clear_pending()
+{
+	for (auto &pending : pending_)
+		pending.clear();
+	bulk_sizes_.clear();
+	bulk_read_ = 0;
+	last_tag_ = 0;
+}
+
+} // namespace libvnc
@@ -0,0 +1,60 @@
+#pragma once
+#include <boost/asio/buffer.hpp>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace libvnc {
+
+/** Outgoing bytes, double buffered. Messages are appended to the pending side
+    from any thread while the other side is being written; each write takes
+    everything that piled up meanwhile, so a burst of small messages goes out
+    in one write. Both sides keep their capacity, so once warmed up sending
+    does not allocate.
+
+    Pending messages are kept per priority class. A write takes all input,
+    then all control messages, then bulk messages up to bulk_chunk bytes, so
+    input queued behind a large transfer waits for at most one write. Messages
+    are never split: RFB has no framing that would allow interleaving inside
+    one, so a single huge bulk message still goes out in one piece. */
+class send_buffer {
+public:
+	enum class priority : uint32_t { input = 0, control, bulk };
+
+	/** Appends id followed by parts. Returns true when no write is in flight and the
+	    caller has to start one. A non-zero merge_tag lets an input message overwrite the
+	    previous one while both wait behind a write, if it carries the same tag and size. */
+	bool append(uint8_t id, std::span<const boost::asio::const_buffer> parts, priority prio,
+		    uint32_t merge_tag = 0);
+
+	/** Hands over what the next write should carry. Empty when there is nothing
+	    left, in which case the buffer is idle again. */
+	std::span<const uint8_t> take();
+
+	/** Drops pending data after a failed write and marks the buffer idle. */
+	void abort();
+	void clear();
+
+private:
+	/* a side grown beyond this by a large message is released after its write */
+	constexpr static std::size_t retained_capacity = 1024 * 1024;
+	constexpr static std::size_t bulk_chunk = 64 * 1024;
+
+	void clear_pending();
+
+	std::mutex mutex_;
+	std::array<std::vector<uint8_t>, 3> pending_;
+	std::deque<std::size_t> bulk_sizes_;
+	/* bulk bytes already handed out, compacted away once they make up half the buffer */
+	std::size_t bulk_read_ = 0;
+	std::vector<uint8_t> writing_;
+	bool busy_ = false;
+	std::size_t last_offset_ = 0;
+	uint32_t last_tag_ = 0;
+};
+
+} // namespace libvnc
@@ -0,0 +1,159 @@
+#include "libvnc-cpp/simd.h"
+#include "pixel/kernels.h"
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <spdlog/spdlog.h>
+
+#if defined(LIBVNC_ARCH_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace libvnc::simd {
+
+namespace detail {
+
+#if defined(LIBVNC_ARCH_X86)
+static std::array<uint32_t, 4> cpuid(int leaf, int subleaf)
+{
+	std::array<uint32_t, 4> regs{};
+#if defined(_MSC_VER)
+	__cpuidex(reinterpret_cast<int *>(regs.data()), leaf, subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	return regs;
+}
+
+static uint64_t xgetbv0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (uint64_t(edx) << 32) | eax;
+#endif
+}
+
+static level detect()
+{
+	auto max_leaf = cpuid(0, 0)[0];
+	auto leaf1 = cpuid(1, 0);
+	if (!(leaf1[3] & (1u << 26)))
+		return level::scalar;
+
+	/* AVX state has to be enabled by the OS, not just present in the CPU */
+	bool osxsave = leaf1[2] & (1u << 27);
+	bool avx = leaf1[2] & (1u << 28);
+	if (max_leaf < 7 || !osxsave || !avx)
+		return level::sse2;
+
+	auto xcr0 = xgetbv0();
+	auto leaf7 = cpuid(7, 0);
+	if ((xcr0 & 0x6) != 0x6 || !(leaf7[1] & (1u << 5)))
+		return level::sse2;
+
+	bool avx512f = leaf7[1] & (1u << 16);
+	bool avx512bw = leaf7[1] & (1u << 30);
+	if ((xcr0 & 0xe6) != 0xe6 || !avx512f || !avx512bw)
+		return level::avx2;
+
+	return level::avx512;
+}
+#elif defined(LIBVNC_HAVE_NEON)
+static level detect()
+{
+	return level::neon;
+}
+#else
+static level detect()
+{
+	return level::scalar;
+}
+#endif
+
+static bool supported(level l)
+{
+	auto best = detected_level();
+	if (l == level::scalar || l == best)
+		return true;
+	if (best == level::neon || l == level::neon)
+		return false;
+	return static_cast<uint32_t>(l) <= static_cast<uint32_t>(best);
+}
+
+static level clamp(level l)
+{
+	while (!supported(l))
+		l = l == level::neon ? level::scalar : static_cast<level>(static_cast<uint32_t>(l) - 1);
+	return l;
+}
+
+static level initial_level()
+{
+	auto result = detected_level();
+	if (const char *env = std::getenv("LIBVNC_SIMD")) {
+		bool known = false;
+		for (auto l : {level::scalar, level::sse2, level::avx2, level::avx512, level::neon}) {
+			if (level_name(l) == env) {
+				result = clamp(l);
+				known = true;
+			}
+		}
+		if (!known)
+			spdlog::warn("Unknown LIBVNC_SIMD value: {}", env);
+	}
+	spdlog::info("Pixel kernels: {} (cpu supports {})", level_name(result), level_name(detected_level()));
+	return result;
+}
+
+static std::atomic<level> &active()
+{
+	static std::atomic<level> current{initial_level()};
+	return current;
+}
+
+} // namespace detail
+
+level detected_level()
+{
+	static const level detected = detail::detect();
+	return detected;
+}
+
+level active_level()
+{
+	return detail::active().load();
+}
+
+level set_level(level l)
+{
+	l = detail::clamp(l);
+	detail::active() = l;
+	pixel::select_kernels(l);
+	return l;
+}
+
+std::string_view level_name(level l)
+{
+	switch (l) {
+	case level::scalar:
+		return "scalar";
+	case level::sse2:
+		return "sse2";
+	case level::avx2:
+		return "avx2";
+	case level::avx512:
+		return "avx512";
+	case level::neon:
+		return "neon";
+	}
+	return "unknown";
+}
+
+} // namespace libvnc::simd
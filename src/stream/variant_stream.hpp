@@ -1,5 +1,7 @@
 #pragma once
+#include <boost/asio/compose.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <chrono>
 #include <type_traits>
 #include <variant>
 #include <vector>
@@ -33,15 +35,26 @@ public:
 		return std::visit([&](auto &t) mutable -> const lowest_layer_type & { return t.lowest_layer(); },
 				  *this);
 	}
+	/* counts the bytes received and the time spent waiting for them, so the
+	   client can estimate throughput without decode time getting in the way */
 	template<typename MutableBufferSequence, typename ReadHandler>
 	auto async_read_some(const MutableBufferSequence &buffers, ReadHandler &&handler)
 	{
-		return std::visit(
-			[&, handler = std::move(handler)](auto &t) mutable {
-				if (!provider_)
-					return t.async_read_some(buffers, std::forward<ReadHandler>(handler));
+		return boost::asio::async_compose<ReadHandler, void(boost::system::error_code, std::size_t)>(
+			[this, buffers, started = false, start = std::chrono::steady_clock::time_point{}](
+				auto &self, boost::system::error_code ec = {}, std::size_t bytes = 0) mutable {
+				if (!started) {
+					started = true;
+					start = std::chrono::steady_clock::now();
+					std::visit([&](auto &t) { t.async_read_some(buffers, std::move(self)); },
+						   *this);
+					return;
+				}
+				bytes_read_ += bytes;
+				read_wait_ += std::chrono::steady_clock::now() - start;
+				self.complete(ec, bytes);
 			},
-			*this);
+			handler, *this);
 	}
 	template<typename ConstBufferSequence, typename WriteHandler>
 	auto async_write_some(const ConstBufferSequence &buffers, WriteHandler &&handler)
@@ -77,8 +90,13 @@ public:
 
 	void set_provider(std::unique_ptr<crypto_provider> &&provider) { provider_ = std::move(provider); }
 
+	std::uint64_t bytes_read() const { return bytes_read_; }
+	std::chrono::steady_clock::duration read_wait() const { return read_wait_; }
+
 private:
 	std::unique_ptr<crypto_provider> provider_;
+	std::uint64_t bytes_read_ = 0;
+	std::chrono::steady_clock::duration read_wait_{};
 };
 
 } // namespace libvnc
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "update_scheduler.hpp"
+#include <algorithm>
+
+namespace libvnc {
+
+void update_scheduler::set_max_idle_interval(clock::duration interval)
+{
+	max_idle_interval_ = std::max<clock::rep>(interval.count(), 0);
+	if (idle_interval_ > max_idle_interval_)
+		idle_interval_ = max_idle_interval_.load();
+}
+
+update_scheduler::clock::duration update_scheduler::max_idle_interval() const
+{
+	return clock::duration(max_idle_interval_.load());
+}
+
+void update_scheduler::reset()
+{
+	idle_interval_ = 0;
+	input_ = false;
+	idle_count_ = 0;
+}
+
+void update_scheduler::on_update(std::size_t damaged_area, std::size_t frame_area)
+{
+	if (input_.exchange(false))
+		idle_count_ = 0;
+
+	/* a cursor blink or a clock is tiny, anything above 1/256 of the frame is activity */
+	if (damaged_area * 256 > frame_area) {
+		idle_count_ = 0;
+		idle_interval_ = 0;
+		return;
+	}
+
+	auto max_interval = max_idle_interval();
+	if (max_interval == clock::duration::zero() || ++idle_count_ < idle_updates)
+		return;
+
+	auto interval = clock::duration(idle_interval_.load());
+	interval = interval == clock::duration::zero() ? clock::duration(first_idle_interval) : interval * 2;
+	idle_interval_ = std::min(interval, max_interval).count();
+}
+
+bool update_scheduler::on_input()
+{
+	input_ = true;
+	return idle_interval_.exchange(0) != 0;
+}
+
+void update_scheduler::set_max_fps(int fps)
+{
+	max_fps_ = std::max(fps, 0);
+}
+
+int update_scheduler::max_fps() const
+{
+	return max_fps_;
+}
+
+update_scheduler::clock::duration update_scheduler::idle_interval() const
+{
+	return clock::duration(idle_interval_.load());
+}
+
+update_scheduler::clock::duration update_scheduler::frame_interval() const
+{
+	int fps = max_fps_;
+	if (fps == 0)
+		return {};
+	return std::chrono::duration_cast<clock::duration>(std::chrono::seconds(1)) / fps;
+}
+
+} // namespace libvnc
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+namespace libvnc {
+
+/** Decides how soon the next update request may go out.
+    On an idle screen every update is empty or tiny, so the interval between
+    requests doubles up to max_idle_interval(). Any larger change or local
+    input goes straight back to requesting at full rate. A frame-rate cap puts
+    a floor under the interval regardless of activity. */
+class update_scheduler {
+public:
+	using clock = std::chrono::steady_clock;
+
+	/** zero (default) disables the idle backoff */
+	void set_max_idle_interval(clock::duration interval);
+	clock::duration max_idle_interval() const;
+	void reset();
+
+	/** Feeds the damaged area of every update. */
+	void on_update(std::size_t damaged_area, std::size_t frame_area);
+	/** Returns true when the client was backed off and a request should go out now. */
+	bool on_input();
+
+	/** zero (default) leaves the rate uncapped */
+	void set_max_fps(int fps);
+	int max_fps() const;
+
+	clock::duration idle_interval() const;
+	clock::duration frame_interval() const;
+
+private:
+	constexpr static int idle_updates = 4;
+	constexpr static auto first_idle_interval = std::chrono::milliseconds(20);
+
+	std::atomic<clock::rep> max_idle_interval_ = 0;
+	std::atomic<clock::rep> idle_interval_ = 0;
+	std::atomic_bool input_ = false;
+	std::atomic_int max_fps_ = 0;
+	int idle_count_ = 0;
+};
+
+} // namespace libvnc